@@ -0,0 +1,93 @@
+/*
+ * Symbols encoded per microsecond by the bit by bit expansion used by
+ * rmt_bytes_encoder and by the lookup table encoder, without and with the
+ * fused brightness levels.
+ */
+#include "led_symbol_lut.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BYTES_PER_LED 3
+#define RESOLUTION_HZ 10000000
+#define MIN_BENCH_NS 200000000LL // run every case at least 0.2 s
+
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+typedef void (*encode_fn_t)(const uint8_t *src, size_t size, uint32_t *dst);
+
+static led_symbol_lut_t lut;
+static uint8_t levels[256];
+static uint32_t bit0, bit1;
+
+static void encode_bitwise(const uint8_t *src, size_t size, uint32_t *dst) {
+  led_symbol_bitwise_encode(bit0, bit1, src, size, dst);
+}
+
+static void encode_lut(const uint8_t *src, size_t size, uint32_t *dst) {
+  led_symbol_lut_encode(&lut, src, size, dst);
+}
+
+static void encode_lut_levels(const uint8_t *src, size_t size, uint32_t *dst) {
+  led_symbol_lut_encode_levels(&lut, levels, src, size, dst);
+}
+
+static double symbols_per_us(encode_fn_t encode, const uint8_t *src,
+                             size_t size, uint32_t *dst) {
+  long long iterations = 0;
+  long long start = now_ns();
+  long long elapsed;
+  do {
+    encode(src, size, dst);
+    iterations++;
+    elapsed = now_ns() - start;
+  } while (elapsed < MIN_BENCH_NS);
+  return (double)iterations * size * 8 * 1000.0 / elapsed;
+}
+
+int main() {
+  const int leds[] = {60, 300, 1000};
+  uint32_t ticks_per_us = RESOLUTION_HZ / 1000000;
+  // WS2812 timing, the same as led_strip_encoder.c
+  bit0 = led_symbol_word(1, 3 * ticks_per_us / 10, 0, 9 * ticks_per_us / 10);
+  bit1 = led_symbol_word(1, 9 * ticks_per_us / 10, 0, 3 * ticks_per_us / 10);
+  led_symbol_lut_init(&lut, bit0, bit1);
+  for (int i = 0; i < 256; i++)
+    levels[i] = (i * 128 + 127) / 255; // half brightness
+
+  printf("encoder,leds,symbols_per_us\n");
+  for (size_t i = 0; i < sizeof(leds) / sizeof(leds[0]); i++) {
+    size_t size = leds[i] * BYTES_PER_LED;
+    uint8_t *src = malloc(size);
+    uint32_t *expected = malloc(size * 8 * sizeof(uint32_t));
+    uint32_t *dst = malloc(size * 8 * sizeof(uint32_t));
+    if (!src || !expected || !dst) {
+      fprintf(stderr, "Out of memory\n");
+      return 1;
+    }
+    for (size_t j = 0; j < size; j++)
+      src[j] = rand();
+
+    encode_bitwise(src, size, expected);
+    encode_lut(src, size, dst);
+    if (memcmp(expected, dst, size * 8 * sizeof(uint32_t)) != 0) {
+      fprintf(stderr, "Lookup table output differs at %d LEDs\n", leds[i]);
+      return 1;
+    }
+
+    printf("bytes,%d,%.1f\n", leds[i],
+           symbols_per_us(encode_bitwise, src, size, dst));
+    printf("lut,%d,%.1f\n", leds[i], symbols_per_us(encode_lut, src, size, dst));
+    printf("lut_levels,%d,%.1f\n", leds[i],
+           symbols_per_us(encode_lut_levels, src, size, dst));
+    free(src);
+    free(expected);
+    free(dst);
+  }
+  return 0;
+}
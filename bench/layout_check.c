@@ -0,0 +1,148 @@
+/*
+ * Logical -> physical LED map of led_layout.c: a few maps computed by hand,
+ * then every wiring x rotation x mirror on several panel sizes must give a
+ * permutation whose mirrored and rotated variants agree with each other.
+ * ctest runs it as the layout test.
+ */
+#include "led_layout.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_LEDS 256
+
+typedef struct {
+  const char *name;
+  led_layout_config_t config;
+  uint16_t width;
+  uint16_t height;
+  uint16_t map[6];
+} expected_t;
+
+/*
+ * 3x2 panel, physical indices:
+ *   zigzag  0 1 2   serpentine  0 1 2
+ *           3 4 5               5 4 3
+ */
+static const expected_t expected[] = {
+    {"zigzag", {3, 2, LED_WIRING_ZIGZAG, LED_ROTATION_0, 0, 0}, 3, 2,
+     {0, 1, 2, 3, 4, 5}},
+    {"serpentine", {3, 2, LED_WIRING_SERPENTINE, LED_ROTATION_0, 0, 0}, 3, 2,
+     {0, 1, 2, 5, 4, 3}},
+    {"serpentine 90", {3, 2, LED_WIRING_SERPENTINE, LED_ROTATION_90, 0, 0}, 2,
+     3, {5, 0, 4, 1, 3, 2}},
+    {"serpentine 90 mirror x",
+     {3, 2, LED_WIRING_SERPENTINE, LED_ROTATION_90, 1, 0}, 2, 3,
+     {0, 5, 1, 4, 2, 3}},
+    {"serpentine 90 mirror y",
+     {3, 2, LED_WIRING_SERPENTINE, LED_ROTATION_90, 0, 1}, 2, 3,
+     {3, 2, 4, 1, 5, 0}},
+    {"serpentine 180 mirror xy",
+     {3, 2, LED_WIRING_SERPENTINE, LED_ROTATION_180, 1, 1}, 3, 2,
+     {0, 1, 2, 5, 4, 3}},
+    {"serpentine 270 mirror x",
+     {3, 2, LED_WIRING_SERPENTINE, LED_ROTATION_270, 1, 0}, 2, 3,
+     {3, 2, 4, 1, 5, 0}},
+    {"zigzag 180", {3, 2, LED_WIRING_ZIGZAG, LED_ROTATION_180, 0, 0}, 3, 2,
+     {5, 4, 3, 2, 1, 0}},
+    {"zigzag 270", {3, 2, LED_WIRING_ZIGZAG, LED_ROTATION_270, 0, 0}, 2, 3,
+     {2, 5, 1, 4, 0, 3}},
+};
+
+static const uint16_t sizes[][2] = {{1, 1}, {3, 2}, {5, 1}, {1, 4},
+                                    {4, 3}, {7, 5}, {16, 16}};
+
+static int check_expected(const expected_t *e) {
+  led_layout_t layout = {0};
+  if (!led_layout_init(&layout, &e->config)) {
+    fprintf(stderr, "%s: out of memory\n", e->name);
+    return 0;
+  }
+  int ok = layout.width == e->width && layout.height == e->height &&
+           !memcmp(layout.map, e->map, sizeof(e->map));
+  if (!ok) {
+    fprintf(stderr, "%s: %ux%u", e->name, layout.width, layout.height);
+    for (int i = 0; i < layout.width * layout.height; i++)
+      fprintf(stderr, " %u", layout.map[i]);
+    fprintf(stderr, "\n");
+  }
+  led_layout_free(&layout);
+  return ok;
+}
+
+/*
+ * Every physical LED appears exactly once
+ */
+static int is_permutation(const led_layout_t *layout, int count) {
+  uint8_t seen[MAX_LEDS] = {0};
+  if (layout->width * layout->height != count)
+    return 0;
+  for (int i = 0; i < count; i++) {
+    if (layout->map[i] >= count || seen[layout->map[i]]++)
+      return 0;
+  }
+  return 1;
+}
+
+static int check_combination(uint16_t cols, uint16_t rows, led_wiring_t wiring,
+                             led_rotation_t rotation) {
+  led_layout_config_t config = {cols, rows, wiring, rotation, 0, 0};
+  led_layout_t plain = {0}, mirrored = {0};
+  int ok = led_layout_init(&plain, &config);
+  int rotated = rotation == LED_ROTATION_90 || rotation == LED_ROTATION_270;
+  ok = ok && plain.width == (rotated ? rows : cols) &&
+       plain.height == (rotated ? cols : rows) &&
+       is_permutation(&plain, cols * rows);
+
+  for (int mirror = 1; ok && mirror < 4; mirror++) {
+    config.mirror_x = mirror & 1;
+    config.mirror_y = mirror >> 1;
+    // Reuses the table of the previous iteration
+    ok = led_layout_init(&mirrored, &config) &&
+         is_permutation(&mirrored, cols * rows);
+    for (uint16_t y = 0; ok && y < plain.height; y++) {
+      for (uint16_t x = 0; ok && x < plain.width; x++) {
+        uint16_t mx = config.mirror_x ? plain.width - 1 - x : x;
+        uint16_t my = config.mirror_y ? plain.height - 1 - y : y;
+        ok = led_layout_index(&mirrored, x, y) ==
+             led_layout_index(&plain, mx, my);
+      }
+    }
+  }
+
+  // 180 degrees is both mirrors of 0 degrees
+  if (ok && rotation == LED_ROTATION_180) {
+    config = (led_layout_config_t){cols, rows, wiring, LED_ROTATION_0, 1, 1};
+    ok = led_layout_init(&mirrored, &config) &&
+         !memcmp(mirrored.map, plain.map, cols * rows * sizeof(uint16_t));
+  }
+  led_layout_free(&plain);
+  led_layout_free(&mirrored);
+  if (!ok)
+    fprintf(stderr, "%ux%u wiring %d rotation %d: wrong map\n", cols, rows,
+            wiring, rotation);
+  return ok;
+}
+
+int main() {
+  int failed = 0;
+  for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+    failed += !check_expected(&expected[i]);
+
+  int combinations = 0;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    for (int wiring = 0; wiring < LED_WIRING_MAX; wiring++) {
+      for (int rotation = 0; rotation < LED_ROTATION_MAX; rotation++) {
+        failed += !check_combination(sizes[i][0], sizes[i][1], wiring,
+                                     rotation);
+        combinations++;
+      }
+    }
+  }
+  if (failed) {
+    fprintf(stderr, "%d layout checks failed\n", failed);
+    return 1;
+  }
+  fprintf(stderr, "%d hand computed maps and %d layouts are right\n",
+          (int)(sizeof(expected) / sizeof(expected[0])), combinations);
+  return 0;
+}
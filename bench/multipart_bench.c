@@ -0,0 +1,270 @@
+/*
+ * Upload parser of the web server: checks that randomly chunked bodies give
+ * back every file byte for byte, then reports MB/s per chunk size.
+ *   multipart_bench [check rounds, default 1000] [check: skip the MB/s]
+ * ctest runs it as the multipart test with "200 check".
+ */
+#include "multipart.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BOUNDARY "----LampFormBoundary7MA4YWxkTrZu0gW"
+#define MAX_FILES 4
+#define MAX_FILE_SIZE 20000
+#define CHECK_ROUNDS 1000 // default
+#define BENCH_FILE_SIZE (256 * 1024)
+#define MIN_BENCH_NS 200000000LL // run every case at least 0.2 s
+
+typedef struct {
+  char filename[MULTIPART_NAME_SIZE];
+  uint8_t *data;
+  size_t size;
+} part_t;
+
+typedef struct {
+  part_t parts[MAX_FILES];
+  int count;
+  int open; // a part was begun and not ended
+  int failed;
+} collected_t;
+
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int on_begin(void *ctx, const char *name, const char *filename) {
+  collected_t *out = ctx;
+  if (out->open || out->count == MAX_FILES ||
+      strcmp(name, filename[0] ? "file" : "note")) {
+    out->failed = 1;
+    return 1;
+  }
+  part_t *part = &out->parts[out->count];
+  strcpy(part->filename, filename);
+  part->size = 0;
+  out->open = 1;
+  return 0;
+}
+
+static int on_data(void *ctx, const uint8_t *data, size_t len) {
+  collected_t *out = ctx;
+  part_t *part = &out->parts[out->count];
+  if (!out->open || part->size + len > MAX_FILE_SIZE) {
+    out->failed = 1;
+    return 1;
+  }
+  memcpy(part->data + part->size, data, len);
+  part->size += len;
+  return 0;
+}
+
+static int on_end(void *ctx) {
+  collected_t *out = ctx;
+  if (!out->open)
+    return out->failed = 1;
+  out->open = 0;
+  out->count++;
+  return 0;
+}
+
+static const multipart_callbacks_t callbacks = {on_begin, on_data, on_end};
+
+static int count_bytes(void *ctx, const uint8_t *data, size_t len) {
+  *(size_t *)ctx += len;
+  return 0;
+}
+static int ignore_begin(void *ctx, const char *name, const char *filename) {
+  return 0;
+}
+static int ignore_end(void *ctx) { return 0; }
+
+static const multipart_callbacks_t counting = {ignore_begin, count_bytes,
+                                               ignore_end};
+
+static int contains_delimiter(const uint8_t *data, size_t size) {
+  const char *delimiter = "\r\n--" BOUNDARY;
+  size_t len = strlen(delimiter);
+  for (size_t i = 0; i + len <= size; i++) {
+    if (!memcmp(data + i, delimiter, len))
+      return 1;
+  }
+  return 0;
+}
+
+/*
+ * Contents full of near misses: line ends, "--" and cut boundaries
+ */
+static void random_contents(uint8_t *data, size_t size) {
+  static const char *traps[] = {"\r", "\r\n", "\r\n-", "\r\n--",
+                                "\r\n--" BOUNDARY, "\r\r\n--", "--" BOUNDARY};
+  size_t i = 0;
+  while (i < size) {
+    if (rand() % 8 == 0) {
+      const char *trap = traps[rand() % (sizeof(traps) / sizeof(traps[0]))];
+      size_t len = strlen(trap);
+      // A full delimiter must not appear, cut the trap short instead
+      if (!strcmp(trap, "\r\n--" BOUNDARY))
+        len -= 1 + rand() % 4;
+      for (size_t j = 0; j < len && i < size; j++)
+        data[i++] = trap[j];
+    } else {
+      data[i++] = rand();
+    }
+  }
+}
+
+static size_t append(uint8_t *body, size_t pos, const void *data,
+                     size_t len) {
+  memcpy(body + pos, data, len);
+  return pos + len;
+}
+
+/*
+ * Builds a form with a text field and count files, returns its size
+ */
+static size_t build_body(uint8_t *body, part_t *files, int count) {
+  char header[256];
+  size_t pos = 0;
+  const char *field = "--" BOUNDARY "\r\n"
+                      "Content-Disposition: form-data; name=\"note\"\r\n"
+                      "\r\n"
+                      "not a file\r\n";
+  pos = append(body, pos, field, strlen(field));
+  for (int i = 0; i < count; i++) {
+    int len = snprintf(header, sizeof(header),
+                       "--" BOUNDARY "\r\n"
+                       "Content-Disposition: form-data; name=\"file\"; "
+                       "filename=\"%s\"\r\n"
+                       "Content-Type: application/octet-stream\r\n"
+                       "\r\n",
+                       files[i].filename);
+    pos = append(body, pos, header, len);
+    pos = append(body, pos, files[i].data, files[i].size);
+    pos = append(body, pos, "\r\n", 2);
+  }
+  const char *close = "--" BOUNDARY "--\r\nepilogue";
+  return append(body, pos, close, strlen(close));
+}
+
+/*
+ * Feeds body in chunks of 1 to max_chunk bytes, returns 1 if the files
+ * came back unchanged. The text field is reported with an empty filename.
+ */
+static int check_chunked(const uint8_t *body, size_t size, part_t *files,
+                         int count, size_t max_chunk, collected_t *out) {
+  multipart_parser_t parser;
+  out->count = 0;
+  out->open = 0;
+  out->failed = 0;
+  multipart_parser_init(&parser, BOUNDARY, &callbacks, out);
+  for (size_t pos = 0; pos < size;) {
+    size_t chunk = 1 + rand() % max_chunk;
+    if (chunk > size - pos)
+      chunk = size - pos;
+    if (!multipart_parser_feed(&parser, body + pos, chunk))
+      return 0;
+    pos += chunk;
+  }
+  if (!multipart_parser_done(&parser) || out->failed ||
+      out->count != count + 1 || out->parts[0].filename[0] ||
+      out->parts[0].size != strlen("not a file"))
+    return 0;
+  for (int i = 0; i < count; i++) {
+    const part_t *part = &out->parts[i + 1];
+    if (strcmp(part->filename, files[i].filename) ||
+        part->size != files[i].size ||
+        memcmp(part->data, files[i].data, part->size))
+      return 0;
+  }
+  return 1;
+}
+
+static double mb_per_s(const uint8_t *body, size_t size, size_t chunk) {
+  long long iterations = 0;
+  long long start = now_ns();
+  long long elapsed;
+  size_t total = 0;
+  do {
+    multipart_parser_t parser;
+    multipart_parser_init(&parser, BOUNDARY, &counting, &total);
+    for (size_t pos = 0; pos < size; pos += chunk)
+      multipart_parser_feed(&parser, body + pos,
+                            chunk < size - pos ? chunk : size - pos);
+    iterations++;
+    elapsed = now_ns() - start;
+  } while (elapsed < MIN_BENCH_NS);
+  return (double)iterations * size * 1000.0 / elapsed;
+}
+
+int main(int argc, char **argv) {
+  int rounds = argc > 1 ? atoi(argv[1]) : CHECK_ROUNDS;
+  int check_only = argc > 2 && !strcmp(argv[2], "check");
+  part_t files[MAX_FILES];
+  collected_t out;
+  uint8_t *body = malloc(MAX_FILES * (MAX_FILE_SIZE + 256) + 1024);
+  for (int i = 0; i < MAX_FILES; i++) {
+    files[i].data = malloc(MAX_FILE_SIZE);
+    out.parts[i].data = malloc(MAX_FILE_SIZE);
+  }
+  if (!body) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  srand(1);
+  for (int round = 0; round < rounds; round++) {
+    int count = 1 + rand() % (MAX_FILES - 1);
+    for (int i = 0; i < count; i++) {
+      snprintf(files[i].filename, sizeof(files[i].filename), "file%d.bin", i);
+      files[i].size = rand() % MAX_FILE_SIZE;
+      // Traps next to each other may form a whole delimiter by chance
+      do
+        random_contents(files[i].data, files[i].size);
+      while (contains_delimiter(files[i].data, files[i].size));
+    }
+    size_t size = build_body(body, files, count);
+    // Mostly tiny chunks, so that delimiters are split everywhere
+    size_t max_chunk = round % 4 == 0 ? 4096 : 1 + rand() % 64;
+    if (!check_chunked(body, size, files, count, max_chunk, &out)) {
+      fprintf(stderr, "Round %d: files differ after chunked parsing\n",
+              round);
+      return 1;
+    }
+  }
+  // A body cut short is never complete
+  size_t size = build_body(body, files, 1);
+  multipart_parser_t parser;
+  multipart_parser_init(&parser, BOUNDARY, &callbacks, &out);
+  out.count = out.open = out.failed = 0;
+  multipart_parser_feed(&parser, body, size - strlen("--\r\nepilogue"));
+  if (multipart_parser_done(&parser)) {
+    fprintf(stderr, "Truncated body was accepted\n");
+    return 1;
+  }
+  fprintf(stderr, "%d randomly chunked uploads parsed correctly\n", rounds);
+  if (check_only)
+    return 0;
+
+  free(body);
+  files[0].size = BENCH_FILE_SIZE;
+  files[0].data = realloc(files[0].data, BENCH_FILE_SIZE);
+  body = malloc(BENCH_FILE_SIZE + 1024);
+  if (!files[0].data || !body) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  strcpy(files[0].filename, "index.html.gz");
+  for (size_t i = 0; i < BENCH_FILE_SIZE; i++)
+    files[0].data[i] = rand(); // like gzip: about one '\r' in 256 bytes
+  size = build_body(body, files, 1);
+
+  const size_t chunks[] = {64, 536, 1460, 4096, 16384};
+  printf("chunk,mb_per_s\n");
+  for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++)
+    printf("%zu,%.1f\n", chunks[i], mb_per_s(body, size, chunks[i]));
+  return 0;
+}
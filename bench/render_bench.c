@@ -0,0 +1,205 @@
+/*
+ * Cost of every stage of the render path at strip lengths from 1 to 4096:
+ *   color   - warm white color of every pixel (get_warm_light)
+ *   fill    - writing colors into the framebuffer (pixel format convert)
+ *   layout  - the same through the logical (x, y) map (traverse_layout)
+ *   composite - base color, a half transparent layer and a pulsing overlay
+ *               blended into the framebuffer (led_compositor_render)
+ *   encode  - framebuffer to RMT symbols with levels (lookup table encoder)
+ *   effect_<name> - one frame of every effect in the registry
+ *
+ * Prints CSV: stage,leds,ns_per_pixel,fps
+ *   render_bench [min ms per case, default 50] [pixel format, default grb]
+ */
+#include "color_tables.h"
+#include "led_compositor.h"
+#include "led_effect.h"
+#include "led_layout.h"
+#include "led_pixel.h"
+#include "led_symbol_lut.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_LEDS 4096
+#define RESOLUTION_HZ 10000000
+
+typedef struct {
+  int leds;
+  const led_pixel_ops_t *ops;
+  uint8_t *pixels;
+  led_color_t *colors;
+  uint32_t *symbols;
+  led_layout_t layout;
+  led_compositor_t compositor;
+  led_effect_instance_t effect;
+  uint32_t now_ms;
+  led_symbol_lut_t lut;
+  uint8_t brightness;
+} bench_ctx_t;
+
+typedef void (*stage_fn_t)(bench_ctx_t *ctx);
+
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Same as in led_strip_wrapper.c
+static led_color_t get_warm_light(uint8_t brightness) {
+  return (led_color_t){.r = warm_white_r[brightness],
+                       .g = warm_white_g[brightness],
+                       .b = warm_white_b[brightness]};
+}
+
+static void stage_color(bench_ctx_t *ctx) {
+  // A gradient, so the compiler can't hoist the lookups out of the loop
+  for (int i = 0; i < ctx->leds; i++)
+    ctx->colors[i] = get_warm_light((uint8_t)(ctx->brightness + i));
+  ctx->brightness++;
+}
+
+static void stage_fill(bench_ctx_t *ctx) {
+  ctx->ops->convert(ctx->pixels, ctx->colors, ctx->leds);
+}
+
+static void stage_layout(bench_ctx_t *ctx) {
+  const uint16_t *index = ctx->layout.map;
+  const led_color_t *color = ctx->colors;
+  void (*set)(uint8_t *, int, led_color_t) = ctx->ops->set;
+  for (int y = 0; y < ctx->layout.height; y++) {
+    for (int x = 0; x < ctx->layout.width; x++)
+      set(ctx->pixels, *index++, *color++);
+  }
+}
+
+static void stage_composite(bench_ctx_t *ctx) {
+  led_compositor_render(&ctx->compositor, &ctx->layout, ctx->ops, ctx->pixels,
+                        ctx->leds);
+}
+
+static void stage_effect(bench_ctx_t *ctx) {
+  led_effect_params_t params = {.color = {.r = 255, .g = 96},
+                                .now_ms = ctx->now_ms};
+  ctx->now_ms += 20; // 50 fps
+  // The kernel itself, without the cost accounting of led_effect_render
+  ctx->effect.effect->render(ctx->colors, ctx->effect.pixels, &params,
+                             ctx->effect.state);
+}
+
+static void stage_encode(bench_ctx_t *ctx) {
+  led_symbol_lut_encode_levels(&ctx->lut, gamma_cie1931, ctx->pixels,
+                               ctx->leds * ctx->ops->bytes_per_pixel,
+                               ctx->symbols);
+}
+
+static double ns_per_frame(stage_fn_t stage, bench_ctx_t *ctx,
+                           long long min_ns) {
+  long long iterations = 0;
+  long long batch = 1; // the clock is read once per batch
+  long long start = now_ns();
+  long long elapsed;
+  do {
+    for (long long i = 0; i < batch; i++)
+      stage(ctx);
+    iterations += batch;
+    batch *= 2;
+    elapsed = now_ns() - start;
+  } while (elapsed < min_ns);
+  return (double)elapsed / iterations;
+}
+
+/*
+ * A matrix as square as possible, serpentine and rotated, so the map is not
+ * the identity
+ */
+static int init_layout(bench_ctx_t *ctx) {
+  int cols = 1;
+  while (cols * cols < ctx->leds)
+    cols++;
+  while (ctx->leds % cols)
+    cols--;
+  led_layout_config_t config = {
+      .cols = cols,
+      .rows = ctx->leds / cols,
+      .wiring = LED_WIRING_SERPENTINE,
+      .rotation = LED_ROTATION_90,
+  };
+  return led_layout_init(&ctx->layout, &config);
+}
+
+int main(int argc, char **argv) {
+  static const struct {
+    const char *name;
+    stage_fn_t fn;
+  } stages[] = {
+      {"color", stage_color},
+      {"fill", stage_fill},
+      {"layout", stage_layout},
+      {"composite", stage_composite},
+      {"encode", stage_encode},
+  };
+  long long min_ns = (argc > 1 ? atoll(argv[1]) : 50) * 1000000LL;
+  const char *format = argc > 2 ? argv[2] : "grb";
+
+  bench_ctx_t ctx = {0};
+  ctx.ops = led_pixel_ops(led_pixel_format_from_name(format));
+  if (!ctx.ops) {
+    fprintf(stderr, "Unknown pixel format %s\n", format);
+    return 1;
+  }
+  size_t bpp = ctx.ops->bytes_per_pixel;
+  ctx.pixels = calloc(MAX_LEDS, bpp);
+  ctx.colors = calloc(MAX_LEDS, sizeof(led_color_t));
+  ctx.symbols = calloc(MAX_LEDS * bpp * 8, sizeof(uint32_t));
+  if (!ctx.pixels || !ctx.colors || !ctx.symbols) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  // The same layers as the lamp with an effect and a notification shown
+  ctx.compositor.count = 3;
+  ctx.compositor.layers[0] =
+      (led_layer_t){.color = get_warm_light(255), .opacity = 255};
+  ctx.compositor.layers[1] = (led_layer_t){.colors = ctx.colors,
+                                           .opacity = 128,
+                                           .mode = LED_BLEND_NORMAL};
+  ctx.compositor.layers[2] = (led_layer_t){
+      .color = {.b = 255}, .opacity = 96, .mode = LED_BLEND_ADD};
+  uint32_t ticks_per_us = RESOLUTION_HZ / 1000000;
+  // WS2812 timing, the same as led_strip_encoder.c
+  led_symbol_lut_init(
+      &ctx.lut,
+      led_symbol_word(1, 3 * ticks_per_us / 10, 0, 9 * ticks_per_us / 10),
+      led_symbol_word(1, 9 * ticks_per_us / 10, 0, 3 * ticks_per_us / 10));
+
+  printf("stage,leds,ns_per_pixel,fps\n");
+  for (int leds = 1; leds <= MAX_LEDS; leds *= 2) {
+    ctx.leds = leds;
+    if (!init_layout(&ctx)) {
+      fprintf(stderr, "Out of memory\n");
+      return 1;
+    }
+    for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); i++) {
+      double ns = ns_per_frame(stages[i].fn, &ctx, min_ns);
+      printf("%s,%d,%.2f,%.0f\n", stages[i].name, leds, ns / leds,
+             1000000000.0 / ns);
+    }
+    for (int i = 0; i < led_effect_count(); i++) {
+      const led_effect_t *effect = led_effect_get(i);
+      if (!led_effect_prepare(&ctx.effect, effect, leds)) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+      }
+      double ns = ns_per_frame(stage_effect, &ctx, min_ns);
+      printf("effect_%s,%d,%.2f,%.0f\n", effect->name, leds, ns / leds,
+             1000000000.0 / ns);
+    }
+  }
+  led_effect_release(&ctx.effect);
+  led_layout_free(&ctx.layout);
+  free(ctx.pixels);
+  free(ctx.colors);
+  free(ctx.symbols);
+  return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef __LED_COLOR_H__
+#define __LED_COLOR_H__
+
+#include "led_pixel.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LED_KELVIN_MIN 1800
+#define LED_KELVIN_MAX 6500
+
+/*
+ * Hue 0-255 is the full circle: 0 red, 85 green, 170 blue
+ */
+typedef struct {
+  uint8_t h;
+  uint8_t s;
+  uint8_t v;
+} led_hsv_t;
+
+/*
+ * Integer only, without a branch on the hue sector, cheap enough for one
+ * conversion per pixel and frame
+ */
+led_color_t led_hsv_to_rgb(led_hsv_t hsv);
+led_hsv_t led_rgb_to_hsv(led_color_t color);
+/*
+ * Black body color at full scale, interpolated in a const table of 100 K
+ * steps. Kelvin is clamped to LED_KELVIN_MIN..MAX.
+ */
+led_color_t led_kelvin_to_rgb(uint32_t kelvin);
+/*
+ * Moves the white part of the color to the white channel, for RGBW strips
+ */
+led_color_t led_rgb_to_rgbw(led_color_t color);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,60 @@
+#ifndef __LED_COMPOSITOR_H__
+#define __LED_COMPOSITOR_H__
+
+#include "led_layout.h"
+#include "led_pixel.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LED_COMPOSITOR_MAX_LAYERS 4
+
+typedef enum {
+  LED_BLEND_NORMAL = 0, // alpha over the layers below
+  LED_BLEND_ADD,        // saturating, for glows and flashes
+  LED_BLEND_MULTIPLY,   // only darkens, for masks and vignettes
+  LED_BLEND_SCREEN,     // only lightens, softer than add
+  LED_BLEND_MAX,
+} led_blend_mode_t;
+
+/*
+ * A layer either has a color per logical pixel (y * width + x) or one color
+ * for all of them. The buffers are owned by the caller and read while the
+ * frame is rendered.
+ */
+typedef struct {
+  const led_color_t *colors; // NULL for a solid layer
+  const uint8_t *alpha;      // coverage per pixel, NULL if fully covered
+  led_color_t color;         // of a solid layer
+  uint8_t opacity;           // 0 hides the layer
+  led_blend_mode_t mode;
+} led_layer_t;
+
+typedef struct {
+  led_layer_t layers[LED_COMPOSITOR_MAX_LAYERS]; // bottom first
+  int count;
+} led_compositor_t;
+
+/*
+ * Returns 1 and the color if every visible layer is solid, the frame can be
+ * sent without the framebuffer then
+ */
+int led_compositor_solid(const led_compositor_t *compositor,
+                         led_color_t *color);
+/*
+ * Blends all layers and writes the result through the layout table into the
+ * framebuffer, in one pass. Pixels are processed in small blocks, so every
+ * layer costs one pass over a block which stays in the cache.
+ */
+void led_compositor_render(const led_compositor_t *compositor,
+                           const led_layout_t *layout,
+                           const led_pixel_ops_t *ops, uint8_t *pixels,
+                           size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,75 @@
+#ifndef __LED_EFFECT_H__
+#define __LED_EFFECT_H__
+
+#include "led_pixel.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  led_color_t color; // base color, used by the effects which need one
+  uint32_t now_ms;
+} led_effect_params_t;
+
+/*
+ * A per frame kernel, integer math only. The state block belongs to one
+ * running instance and is sized for its pixels.
+ */
+typedef struct {
+  const char *name;
+  uint8_t animated; // 0 if every frame is the same, it is drawn once then
+  size_t (*state_size)(size_t pixels); // NULL if the effect has no state
+  void (*init)(void *state, size_t pixels);
+  void (*render)(led_color_t *out, size_t pixels,
+                 const led_effect_params_t *params, void *state);
+} led_effect_t;
+
+/*
+ * Effect with its state, prepared for a number of pixels
+ */
+typedef struct {
+  const led_effect_t *effect;
+  void *state;
+  size_t pixels;
+} led_effect_instance_t;
+
+/*
+ * Effects are numbered in the registry order, the numbers are saved in NVS,
+ * so new effects go to the end. 0 is solid.
+ */
+int led_effect_count();
+/*
+ * NULL if index is out of range
+ */
+const led_effect_t *led_effect_get(int index);
+/*
+ * Index of the effect with the name, -1 if there is none
+ */
+int led_effect_find(const char *name);
+
+/*
+ * (Re)allocates and initializes the state if the effect or the number of
+ * pixels changed. Returns 0 if there is not enough memory, the instance is
+ * empty then and renders nothing.
+ */
+int led_effect_prepare(led_effect_instance_t *instance,
+                       const led_effect_t *effect, size_t pixels);
+void led_effect_release(led_effect_instance_t *instance);
+/*
+ * Runs the kernel and adds its time to the cost of the effect
+ */
+void led_effect_render(led_effect_instance_t *instance, led_color_t *out,
+                       const led_effect_params_t *params);
+/*
+ * Average cost of the effect measured on this device in ns per pixel, 0 until
+ * it has been rendered
+ */
+uint32_t led_effect_cost_ns(int index);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,49 @@
+#ifndef __LED_FRAME_H__
+#define __LED_FRAME_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LED_MAX_BYTES_PER_PIXEL 6 // 16 bits per channel RGB
+
+/**
+ * @brief Pixels of one frame
+ *
+ * Pixels stay unscaled, levels are applied to every byte while the frame is
+ * sent. Both must stay valid until the frame is transmitted.
+ */
+typedef struct {
+  const uint8_t *pixels; /*!< Pixel bytes in the wire order */
+  size_t size;           /*!< Number of bytes in pixels */
+  const uint8_t *levels; /*!< 256-entry output table, NULL to send as is */
+} led_frame_t;
+
+/**
+ * @brief One pixel repeated count times
+ */
+typedef struct {
+  uint8_t pixel[LED_MAX_BYTES_PER_PIXEL]; /*!< Bytes in the wire order */
+  uint8_t bytes_per_pixel;                /*!< Number of used bytes */
+  uint32_t count;                         /*!< Number of LEDs to fill */
+  const uint8_t *levels; /*!< 256-entry output table, NULL to send as is */
+} led_solid_frame_t;
+
+/**
+ * @brief Frame handed over to a transport
+ */
+typedef struct {
+  int is_solid; /*!< Which member is used */
+  union {
+    led_frame_t pixels;
+    led_solid_frame_t solid;
+  };
+} led_transport_frame_t;
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,57 @@
+#ifndef __LED_LAYOUT_H__
+#define __LED_LAYOUT_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  LED_WIRING_ZIGZAG = 0, // every row starts on the same side
+  LED_WIRING_SERPENTINE, // every other row runs backwards
+  LED_WIRING_MAX,
+} led_wiring_t;
+
+typedef enum {
+  LED_ROTATION_0 = 0,
+  LED_ROTATION_90, // clockwise
+  LED_ROTATION_180,
+  LED_ROTATION_270,
+  LED_ROTATION_MAX,
+} led_rotation_t;
+
+typedef struct {
+  uint16_t cols; // LEDs in a physical row, in wiring order
+  uint16_t rows;
+  led_wiring_t wiring;
+  led_rotation_t rotation;
+  uint8_t mirror_x; // applied after the rotation
+  uint8_t mirror_y;
+} led_layout_config_t;
+
+/*
+ * Logical (x, y) -> physical LED index table, built once, so effects address
+ * pixels with a single load instead of per pixel arithmetic
+ */
+typedef struct {
+  uint16_t width; // logical size, cols and rows are swapped by 90/270
+  uint16_t height;
+  uint16_t *map;
+} led_layout_t;
+
+/*
+ * Returns 0 if there is not enough memory, the old table is kept then
+ */
+int led_layout_init(led_layout_t *layout, const led_layout_config_t *config);
+void led_layout_free(led_layout_t *layout);
+
+static inline uint16_t led_layout_index(const led_layout_t *layout, uint16_t x,
+                                        uint16_t y) {
+  return layout->map[y * layout->width + x];
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
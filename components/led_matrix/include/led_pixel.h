@@ -0,0 +1,60 @@
+#ifndef __LED_PIXEL_H__
+#define __LED_PIXEL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Byte order on the wire. 16-bit formats send every channel as v * 257 (big
+ * endian), so the 8-bit output levels of the encoder stay exact for them.
+ */
+typedef enum {
+  LED_PIXEL_GRB = 0, // WS2812
+  LED_PIXEL_RGB,
+  LED_PIXEL_GRBW, // SK6812 RGBW
+  LED_PIXEL_RGBW,
+  LED_PIXEL_GRB16, // 16 bits per channel
+  LED_PIXEL_RGB16,
+  LED_PIXEL_MAX,
+} led_pixel_format_t;
+
+typedef struct {
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+  uint8_t w; // ignored by the formats without a white channel
+} led_color_t;
+
+/*
+ * Routines specialized for one format, they are picked once when the format
+ * is set, so the per pixel loops don't switch on it
+ */
+typedef struct {
+  const char *name;
+  uint8_t bytes_per_pixel;
+  uint8_t has_white;
+  void (*set)(uint8_t *pixels, int index, led_color_t color);
+  void (*fill)(uint8_t *pixels, size_t count, led_color_t color);
+  void (*convert)(uint8_t *pixels, const led_color_t *colors, size_t count);
+  // colors[i] goes to the LED map[i], e.g. through a layout table
+  void (*scatter)(uint8_t *pixels, const uint16_t *map,
+                  const led_color_t *colors, size_t count);
+} led_pixel_ops_t;
+
+/*
+ * NULL for an unknown format
+ */
+const led_pixel_ops_t *led_pixel_ops(led_pixel_format_t format);
+/*
+ * LED_PIXEL_MAX if the name is unknown
+ */
+led_pixel_format_t led_pixel_format_from_name(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
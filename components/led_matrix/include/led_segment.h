@@ -0,0 +1,57 @@
+#ifndef __LED_SEGMENT_H__
+#define __LED_SEGMENT_H__
+
+#include "led_effect.h"
+#include "led_pixel.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LED_MAX_SEGMENTS 8
+#define LED_SEGMENT_NAME_SIZE 16
+
+/*
+ * A named zone of the strip. Positions count logical pixels row by row, on a
+ * single row strip they are the LED numbers.
+ */
+typedef struct {
+  char name[LED_SEGMENT_NAME_SIZE];
+  uint16_t start;
+  uint16_t length;
+  uint8_t reverse;    // effects run from the last pixel to the first
+  uint8_t brightness; // 0-255, on top of the lamp brightness
+  uint8_t effect;     // index in the effect registry
+  led_color_t color;
+} led_segment_t;
+
+/*
+ * Returns 1 if the segment has a name and fits into pixels
+ */
+int led_segment_is_valid(const led_segment_t *segment, size_t pixels);
+/*
+ * Index of the segment with the name, -1 if there is none
+ */
+int led_segment_find(const led_segment_t *segments, int count,
+                     const char *name);
+/*
+ * Returns 1 if any of the segments runs an animated effect
+ */
+int led_segments_animated(const led_segment_t *segments, int count);
+/*
+ * Runs the effect of every segment into a compositor layer of pixels colors,
+ * effects[i] keeps the state of segments[i] between frames. Covered pixels
+ * get alpha 255, the rest 0, so the layers below show through there.
+ * Segments which overlap are drawn in order, the last one wins.
+ */
+void led_segments_render(const led_segment_t *segments,
+                         led_effect_instance_t *effects, int count,
+                         led_color_t *colors, uint8_t *alpha, size_t pixels,
+                         uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
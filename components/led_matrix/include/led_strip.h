@@ -1,25 +1,108 @@
 #ifndef __LED_STRIP_H__
 #define __LED_STRIP_H__
 
+#include "led_color.h"
+#include "led_layout.h"
+#include "led_pixel.h"
+#include "led_transport.h"
 #include <stddef.h>
 #include <stdint.h>
+
+typedef enum {
+  LED_COLOR_WARM = 0, // white of CONFIG_LAMP_WARM_WHITE_KELVIN
+  LED_COLOR_HSV,
+  LED_COLOR_KELVIN,
+} led_color_mode_t;
+
 typedef struct {
   int gpio_num;
   int is_initiated;
-  uint8_t cols;
-  uint8_t rows;
+  uint16_t cols;
+  uint16_t rows;
+  uint8_t bytes_per_pixel;
+  led_pixel_format_t pixel_format;
+  const led_pixel_ops_t *pixel_ops; // routines of pixel_format
+  led_layout_config_t layout_config;
+  led_layout_t layout; // logical (x, y) -> LED index
   uint8_t brightness;
+  led_color_mode_t color_mode;
+  led_hsv_t color; // of LED_COLOR_HSV
+  uint16_t kelvin; // of LED_COLOR_KELVIN
   uint8_t *p_pixels;
   int pixels_size;
 } led_strip_state_t;
+typedef struct {
+  uint32_t frames_sent;
+  uint32_t frames_skipped; // equal to the previous frame, not transmitted
+} led_output_stats_t;
 /*
  * Callback function which receive pixelsArray and led index (starts from 0)
  */
 typedef void (*led_callback_t)(uint8_t *p_pixels, int led_index);
+typedef void (*led_xy_callback_t)(uint8_t *p_pixels, int led_index, int x,
+                                  int y);
 
+/*
+ * Blocking transmission, the bytes are sent as is
+ */
 void transmit_pixels_data(uint8_t *p_pixels, size_t size);
+/*
+ * Brightness (0-255) and optional 256-entry gamma table applied by the encoder
+ * to every byte of the frames presented after this call. The framebuffer is
+ * never rewritten, gamma has to stay valid while it is in use.
+ */
+void set_output_levels(uint8_t brightness, const uint8_t *gamma);
+/*
+ * Double buffered output, call after init_led_channels(). The back buffer keeps
+ * the frame before the previous one, so it has to be redrawn completely.
+ */
+void init_framebuffer(size_t pixels, size_t bytes_per_pixel);
+/*
+ * Waits until nothing is on the wire and reallocates both buffers, the
+ * acquired back buffer is released. Returns 0 and keeps the old buffers if
+ * there is not enough memory.
+ */
+int resize_framebuffer(size_t pixels, size_t bytes_per_pixel);
+/*
+ * Returns the back buffer, waits if it is still being transmitted
+ */
+uint8_t *acquire_back_buffer();
+/*
+ * Queues the back buffer for transmission and swaps the buffers, doesn't wait
+ */
+void present_back_buffer();
+/*
+ * Sends one pixel to count LEDs without touching the framebuffer, the back
+ * buffer slot is consumed the same way as by present_back_buffer()
+ */
+void present_solid_color(const uint8_t *pixel, size_t bytes_per_pixel,
+                         size_t count);
+/*
+ * Frames passed to present_*() which were sent or skipped as unchanged
+ */
+void get_output_stats(led_output_stats_t *stats);
 void traverse_matrix(uint8_t *p_pixels, led_callback_t callback,
                      int chase_speed, int led_per_col, int led_per_row);
-void init_rmt_encoder(int gpio_num);
+/*
+ * Calls callback for every logical (x, y) with its physical LED index
+ */
+void traverse_layout(uint8_t *p_pixels, const led_layout_t *layout,
+                     led_xy_callback_t callback);
+/*
+ * One output channel per GPIO over the transport selected in menuconfig. The
+ * framebuffer is split evenly between them, the first pixels go to the first
+ * GPIO. All channels of a frame are started together (synchronized in
+ * hardware where the transport supports it).
+ */
+void init_led_channels(const int *gpio_nums, int count);
+/*
+ * Same with a transport created by the caller, it is owned by the strip then
+ */
+void init_led_transport(led_transport_t *transport, const int *gpio_nums,
+                        int count);
+/*
+ * Waits for the queued frames and releases the transport
+ */
+void deinit_led_transport();
 void reset_pixels_array(uint8_t *p_pixels, size_t size);
 #endif
@@ -7,22 +7,34 @@
 #define __LED_STRIP_ENCODER_H__
 
 #include "driver/rmt_encoder.h"
+#include "led_frame.h"
 #include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief How pixel bytes are turned into RMT symbols
+ */
+typedef enum {
+  LED_STRIP_ENCODER_BYTES = 0, /*!< rmt_bytes_encoder, bit by bit in the ISR */
+  LED_STRIP_ENCODER_LUT, /*!< 256-entry table of prebuilt symbols (8 KB) */
+} led_strip_encoder_type_t;
+
 /**
  * @brief Type of led strip encoder configuration
  */
 typedef struct {
   uint32_t resolution; /*!< Encoder resolution, in Hz */
+  led_strip_encoder_type_t type; /*!< Encoder implementation */
 } led_strip_encoder_config_t;
 
 /**
  * @brief Create RMT encoder for encoding LED strip pixels into RMT symbols
  *
+ * Takes led_frame_t as the payload.
+ *
  * @param[in] config Encoder configuration
  * @param[out] ret_encoder Returned encoder handle
  * @return
@@ -33,6 +45,22 @@ typedef struct {
 esp_err_t rmt_new_led_strip_encoder(const led_strip_encoder_config_t *config,
                                     rmt_encoder_handle_t *ret_encoder);
 
+/**
+ * @brief Create RMT encoder which sends one pixel to every LED of the strip
+ *
+ * Takes led_solid_frame_t as the payload, so a uniform frame doesn't need a
+ * framebuffer of the strip length.
+ *
+ * @param[in] config Encoder configuration
+ * @param[out] ret_encoder Returned encoder handle
+ * @return
+ *      - ESP_ERR_INVALID_ARG for any invalid arguments
+ *      - ESP_ERR_NO_MEM out of memory when creating led solid encoder
+ *      - ESP_OK if creating encoder successfully
+ */
+esp_err_t rmt_new_led_solid_encoder(const led_strip_encoder_config_t *config,
+                                    rmt_encoder_handle_t *ret_encoder);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,50 @@
+#ifndef __LED_SYMBOL_LUT_H__
+#define __LED_SYMBOL_LUT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * RMT symbol words (rmt_symbol_word_t.val) for every byte value, MSB first.
+ * Plain C without driver headers, so the encoding can be benchmarked on host.
+ */
+typedef struct {
+  uint32_t symbols[256][8];
+} led_symbol_lut_t;
+
+/*
+ * Packs one RMT symbol: duration0 [14:0], level0 [15], duration1 [30:16],
+ * level1 [31]
+ */
+static inline uint32_t led_symbol_word(uint32_t level0, uint32_t duration0,
+                                       uint32_t level1, uint32_t duration1) {
+  return (duration0 & 0x7fff) | ((level0 & 1) << 15) |
+         ((duration1 & 0x7fff) << 16) | ((level1 & 1) << 31);
+}
+
+void led_symbol_lut_init(led_symbol_lut_t *lut, uint32_t bit0, uint32_t bit1);
+/*
+ * Writes size * 8 symbols into dst, one block copy per byte
+ */
+void led_symbol_lut_encode(const led_symbol_lut_t *lut, const uint8_t *src,
+                           size_t size, uint32_t *dst);
+/*
+ * The same with every byte passed through levels[] first (brightness, gamma)
+ */
+void led_symbol_lut_encode_levels(const led_symbol_lut_t *lut,
+                                  const uint8_t *levels, const uint8_t *src,
+                                  size_t size, uint32_t *dst);
+/*
+ * Bit by bit expansion, the way rmt_bytes_encoder does it
+ */
+void led_symbol_bitwise_encode(uint32_t bit0, uint32_t bit1,
+                               const uint8_t *src, size_t size, uint32_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
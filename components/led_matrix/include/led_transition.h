@@ -0,0 +1,59 @@
+#ifndef __LED_TRANSITION_H__
+#define __LED_TRANSITION_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  LED_EASING_LINEAR = 0,
+  LED_EASING_IN,     // quadratic, slow start
+  LED_EASING_OUT,    // quadratic, slow end
+  LED_EASING_IN_OUT, // smoothstep
+  LED_EASING_MAX,
+} led_easing_t;
+
+/*
+ * Time based transition of one 16-bit fixed point value. It is stepped once
+ * per frame, so its cost doesn't depend on the strip length.
+ */
+typedef struct {
+  uint16_t from;
+  uint16_t to;
+  uint16_t value; // current value
+  led_easing_t easing;
+  uint32_t start_ms;
+  uint32_t duration_ms; // 0 when finished
+} led_transition_t;
+
+/*
+ * Jumps to value without a transition
+ */
+void led_transition_set(led_transition_t *transition, uint16_t value);
+/*
+ * Starts from the current value, so a running transition is continued
+ * smoothly towards the new target
+ */
+void led_transition_start(led_transition_t *transition, uint16_t target,
+                          uint32_t duration_ms, led_easing_t easing,
+                          uint32_t now_ms);
+/*
+ * Advances the transition to now_ms and returns the current value
+ */
+uint16_t led_transition_step(led_transition_t *transition, uint32_t now_ms);
+
+static inline int led_transition_active(const led_transition_t *transition) {
+  return transition->duration_ms != 0;
+}
+
+/*
+ * Maps progress (0..65535) through the easing curve
+ */
+uint16_t led_ease(led_easing_t easing, uint16_t progress);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,96 @@
+#ifndef __LED_TRANSPORT_H__
+#define __LED_TRANSPORT_H__
+
+#include "esp_err.h"
+#include "led_frame.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/cdefs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef __containerof // not defined by the host libc
+#define __containerof(ptr, type, member)                                       \
+  ((type *)((char *)(ptr) - offsetof(type, member)))
+#endif
+
+#define LED_MAX_CHANNELS 4
+#define LED_MAX_PIXELS 4096 // per strip, all channels together
+
+/**
+ * @brief Called once for every frame a channel has finished, possibly from an
+ * ISR. Returns true if a higher priority task was woken.
+ */
+typedef bool (*led_transport_done_cb_t)(int channel, void *user_ctx);
+
+typedef struct led_transport_t led_transport_t;
+
+/**
+ * @brief Sends frames to the LEDs over one or more channels
+ *
+ * Frames of a channel complete in the order they were transmitted, the
+ * payload must stay valid until then.
+ */
+struct led_transport_t {
+  /**
+   * @brief Sets up one channel per GPIO, channels of one frame start together
+   * where the hardware allows it
+   */
+  esp_err_t (*init)(led_transport_t *transport, const int *gpio_nums,
+                    int count, led_transport_done_cb_t on_done,
+                    void *user_ctx);
+  /**
+   * @brief Queues the frame on the channel, doesn't wait
+   */
+  esp_err_t (*transmit)(led_transport_t *transport, int channel,
+                        const led_transport_frame_t *frame);
+  /**
+   * @brief Waits until all frames of the channel are transmitted
+   */
+  esp_err_t (*wait)(led_transport_t *transport, int channel);
+  /**
+   * @brief Releases the channels and the transport itself
+   */
+  esp_err_t (*deinit)(led_transport_t *transport);
+};
+
+/**
+ * @brief RMT channel per GPIO, frames are turned into symbols by the encoder
+ * selected in menuconfig
+ */
+esp_err_t led_new_rmt_transport(led_transport_t **ret_transport);
+
+/**
+ * @brief MOSI line of an SPI host per GPIO (SPI2, SPI3), every LED bit is sent
+ * as 3 SPI bits with DMA. Uses more RAM than RMT but no CPU while sending.
+ */
+esp_err_t led_new_spi_transport(led_transport_t **ret_transport);
+
+typedef struct {
+  FILE *file; /*!< Frames are appended to it, NULL keeps them in memory only */
+} led_host_transport_config_t;
+
+/**
+ * @brief Records frames instead of sending them, for host builds
+ *
+ * Every frame is expanded to the bytes which would be on the wire (levels
+ * applied, solid frames repeated). The last one of each channel is kept in
+ * memory, the file gets records of a uint32_t channel, a uint32_t size (host
+ * byte order) and the bytes.
+ */
+esp_err_t led_new_host_transport(const led_host_transport_config_t *config,
+                                 led_transport_t **ret_transport);
+
+/**
+ * @brief Last frame recorded by the host transport on the channel
+ */
+const uint8_t *led_host_transport_frame(led_transport_t *transport,
+                                        int channel, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,96 @@
+#include "led_color.h"
+#include "kelvin_table.h"
+
+#if KELVIN_TABLE_FIRST != LED_KELVIN_MIN || KELVIN_TABLE_LAST != LED_KELVIN_MAX
+#error "kelvin_table.h does not cover LED_KELVIN_MIN..LED_KELVIN_MAX"
+#endif
+
+static inline int32_t clamp8(int32_t value) {
+  return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+static inline int32_t abs32(int32_t value) {
+  return value < 0 ? -value : value;
+}
+
+/*
+ * a * b / 255 rounded
+ */
+static inline uint8_t mul8(uint32_t a, uint32_t b) {
+  uint32_t x = a * b + 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+led_color_t led_hsv_to_rgb(led_hsv_t hsv) {
+  // Every channel is a trapezoid over the hue scaled to 0..1530, clamps
+  // compile to conditional moves
+  int32_t h6 = hsv.h * 6;
+  int32_t r = clamp8(abs32(h6 - 765) - 255);
+  int32_t g = clamp8(510 - abs32(h6 - 510));
+  int32_t b = clamp8(510 - abs32(h6 - 1020));
+  // Saturation mixes in white, value scales the result
+  uint8_t white = 255 - hsv.s;
+  return (led_color_t){
+      .r = mul8(mul8(r, hsv.s) + white, hsv.v),
+      .g = mul8(mul8(g, hsv.s) + white, hsv.v),
+      .b = mul8(mul8(b, hsv.s) + white, hsv.v),
+  };
+}
+
+led_hsv_t led_rgb_to_hsv(led_color_t color) {
+  int32_t r = color.r, g = color.g, b = color.b;
+  int32_t max = r > g ? (r > b ? r : b) : (g > b ? g : b);
+  int32_t min = r < g ? (r < b ? r : b) : (g < b ? g : b);
+  int32_t delta = max - min;
+  led_hsv_t hsv = {.v = max};
+  if (!delta)
+    return hsv; // grey, the hue doesn't matter
+  hsv.s = (delta * 255 + max / 2) / max;
+  // The same 0..1530 scale as led_hsv_to_rgb
+  int32_t h6;
+  if (max == r)
+    h6 = 255 * (g - b) / delta;
+  else if (max == g)
+    h6 = 510 + 255 * (b - r) / delta;
+  else
+    h6 = 1020 + 255 * (r - g) / delta;
+  if (h6 < 0)
+    h6 += 1530;
+  hsv.h = (h6 + 3) / 6;
+  return hsv;
+}
+
+/*
+ * a / b rounded to nearest for b > 0, the same way for negative a: plain
+ * division truncates toward zero and would round those up
+ */
+static int32_t div_round(int32_t a, int32_t b) {
+  return (a < 0 ? a - b / 2 : a + b / 2) / b;
+}
+
+led_color_t led_kelvin_to_rgb(uint32_t kelvin) {
+  if (kelvin < LED_KELVIN_MIN)
+    kelvin = LED_KELVIN_MIN;
+  if (kelvin > LED_KELVIN_MAX)
+    kelvin = LED_KELVIN_MAX;
+  uint32_t index = (kelvin - KELVIN_TABLE_FIRST) / KELVIN_TABLE_STEP;
+  int32_t frac = (kelvin - KELVIN_TABLE_FIRST) % KELVIN_TABLE_STEP;
+  const uint8_t *low = &kelvin_table_rgb[index * 3];
+  // The last entry is LED_KELVIN_MAX itself, frac is 0 there
+  const uint8_t *high = frac ? low + 3 : low;
+  uint8_t rgb[3];
+  for (int i = 0; i < 3; i++)
+    rgb[i] =
+        low[i] + div_round((high[i] - low[i]) * frac, KELVIN_TABLE_STEP);
+  return (led_color_t){.r = rgb[0], .g = rgb[1], .b = rgb[2]};
+}
+
+led_color_t led_rgb_to_rgbw(led_color_t color) {
+  uint8_t white = color.r < color.g ? color.r : color.g;
+  if (color.b < white)
+    white = color.b;
+  return (led_color_t){.r = color.r - white,
+                       .g = color.g - white,
+                       .b = color.b - white,
+                       .w = color.w + white > 255 ? 255 : color.w + white};
+}
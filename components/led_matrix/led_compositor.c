@@ -0,0 +1,153 @@
+#include "led_compositor.h"
+#include <string.h>
+
+#define BLOCK_PIXELS 64 // 256 bytes of colors on the stack
+
+typedef void (*blend_span_t)(led_color_t *dst, const led_layer_t *layer,
+                             size_t first, size_t count);
+
+/*
+ * a * b / 255 rounded, exact for all 8-bit values
+ */
+static inline uint8_t mul8(uint32_t a, uint32_t b) {
+  uint32_t x = a * b + 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+static inline uint8_t mix8(uint8_t d, uint8_t s, uint8_t a) {
+  return mul8(s, a) + mul8(d, 255 - a); // never above 255
+}
+
+static inline uint8_t blend_normal(uint8_t d, uint8_t s, uint8_t a) {
+  return mix8(d, s, a);
+}
+
+static inline uint8_t blend_add(uint8_t d, uint8_t s, uint8_t a) {
+  uint32_t v = d + mul8(s, a);
+  return v > 255 ? 255 : v;
+}
+
+static inline uint8_t blend_multiply(uint8_t d, uint8_t s, uint8_t a) {
+  return mix8(d, mul8(d, s), a);
+}
+
+static inline uint8_t blend_screen(uint8_t d, uint8_t s, uint8_t a) {
+  return mix8(d, s + d - mul8(s, d), a);
+}
+
+#define BLEND_PIXEL(mode, d, s, a)                                             \
+  do {                                                                         \
+    (d).r = blend_##mode((d).r, (s).r, a);                                     \
+    (d).g = blend_##mode((d).g, (s).g, a);                                     \
+    (d).b = blend_##mode((d).b, (s).b, a);                                     \
+    (d).w = blend_##mode((d).w, (s).w, a);                                     \
+  } while (0)
+
+/*
+ * Blends count pixels of the layer starting at first into dst. The mode is
+ * inlined and the common cases get their own loop, so there is no branch per
+ * pixel and the compiler can vectorize them.
+ */
+#define LED_BLEND_SPAN(mode)                                                   \
+  static void span_##mode(led_color_t *dst, const led_layer_t *layer,          \
+                          size_t first, size_t count) {                        \
+    const led_color_t *src = layer->colors ? layer->colors + first : NULL;     \
+    const uint8_t *alpha = layer->alpha ? layer->alpha + first : NULL;         \
+    const led_color_t color = layer->color;                                    \
+    const uint8_t opacity = layer->opacity;                                    \
+    if (!src && !alpha) {                                                      \
+      for (size_t i = 0; i < count; i++)                                       \
+        BLEND_PIXEL(mode, dst[i], color, opacity);                             \
+    } else if (!alpha) {                                                       \
+      for (size_t i = 0; i < count; i++)                                       \
+        BLEND_PIXEL(mode, dst[i], src[i], opacity);                            \
+    } else {                                                                   \
+      for (size_t i = 0; i < count; i++) {                                     \
+        uint8_t a = mul8(opacity, alpha[i]);                                   \
+        BLEND_PIXEL(mode, dst[i], src ? src[i] : color, a);                    \
+      }                                                                        \
+    }                                                                          \
+  }
+
+LED_BLEND_SPAN(normal)
+LED_BLEND_SPAN(add)
+LED_BLEND_SPAN(multiply)
+LED_BLEND_SPAN(screen)
+
+static const blend_span_t blend_spans[LED_BLEND_MAX] = {
+    [LED_BLEND_NORMAL] = span_normal,
+    [LED_BLEND_ADD] = span_add,
+    [LED_BLEND_MULTIPLY] = span_multiply,
+    [LED_BLEND_SCREEN] = span_screen,
+};
+
+static blend_span_t blend_span(const led_layer_t *layer) {
+  return layer->mode < LED_BLEND_MAX ? blend_spans[layer->mode] : span_normal;
+}
+
+/*
+ * An opaque normal layer hides everything below it, it is copied instead of
+ * blended
+ */
+static int is_opaque(const led_layer_t *layer) {
+  return layer->mode == LED_BLEND_NORMAL && layer->opacity == 255 &&
+         !layer->alpha;
+}
+
+int led_compositor_solid(const led_compositor_t *compositor,
+                         led_color_t *color) {
+  led_color_t result = {0};
+  for (int i = 0; i < compositor->count; i++) {
+    const led_layer_t *layer = &compositor->layers[i];
+    if (!layer->opacity)
+      continue;
+    if (layer->colors || layer->alpha)
+      return 0;
+    blend_span(layer)(&result, layer, 0, 1);
+  }
+  *color = result;
+  return 1;
+}
+
+void led_compositor_render(const led_compositor_t *compositor,
+                           const led_layout_t *layout,
+                           const led_pixel_ops_t *ops, uint8_t *pixels,
+                           size_t count) {
+  // The layers below the topmost opaque one are never visible
+  int bottom = 0;
+  for (int i = 0; i < compositor->count; i++) {
+    if (is_opaque(&compositor->layers[i]))
+      bottom = i;
+  }
+  // Without a table of the same size the pixels are written in wiring order
+  const uint16_t *map = NULL;
+  if (layout && layout->map && (size_t)layout->width * layout->height == count)
+    map = layout->map;
+
+  led_color_t block[BLOCK_PIXELS];
+  for (size_t first = 0; first < count; first += BLOCK_PIXELS) {
+    size_t n = count - first < BLOCK_PIXELS ? count - first : BLOCK_PIXELS;
+    const led_layer_t *base = &compositor->layers[bottom];
+    int next = bottom + 1;
+    if (bottom < compositor->count && is_opaque(base)) {
+      if (base->colors) {
+        memcpy(block, base->colors + first, n * sizeof(led_color_t));
+      } else {
+        for (size_t i = 0; i < n; i++)
+          block[i] = base->color;
+      }
+    } else {
+      memset(block, 0, n * sizeof(led_color_t));
+      next = 0;
+    }
+    for (int i = next; i < compositor->count; i++) {
+      const led_layer_t *layer = &compositor->layers[i];
+      if (layer->opacity)
+        blend_span(layer)(block, layer, first, n);
+    }
+    if (map)
+      ops->scatter(pixels, map + first, block, n);
+    else
+      ops->convert(pixels + first * ops->bytes_per_pixel, block, n);
+  }
+}
@@ -0,0 +1,287 @@
+#include "led_effect.h"
+#include "led_color.h"
+#include "led_transition.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BREATHE_PERIOD_MS 4000
+#define RAINBOW_MS_PER_HUE 8 // full circle in about 2 seconds
+#define CHASE_MS_PER_STEP 40
+#define CHASE_TAIL 8
+#define TWINKLE_FADE_MS 600 // from full to dark
+#define FIRE_COOLING 55
+#define FIRE_SPARKING 120
+#define COST_SMOOTHING 3 // cost moves 1/8 of the way to every sample
+
+static inline uint8_t scale8(uint8_t value, uint8_t scale) {
+  return (value * scale + 127) / 255;
+}
+
+static inline led_color_t scale_color(led_color_t color, uint8_t scale) {
+  return (led_color_t){.r = scale8(color.r, scale),
+                       .g = scale8(color.g, scale),
+                       .b = scale8(color.b, scale),
+                       .w = scale8(color.w, scale)};
+}
+
+static inline uint8_t qadd8(uint8_t a, uint8_t b) {
+  return a + b > 255 ? 255 : a + b;
+}
+
+static inline uint8_t qsub8(uint8_t a, uint8_t b) { return a > b ? a - b : 0; }
+
+static inline uint32_t xorshift32(uint32_t *seed) {
+  uint32_t x = *seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *seed = x;
+}
+
+static void fill(led_color_t *out, size_t pixels, led_color_t color) {
+  for (size_t i = 0; i < pixels; i++)
+    out[i] = color;
+}
+
+static void solid_render(led_color_t *out, size_t pixels,
+                         const led_effect_params_t *params, void *state) {
+  fill(out, pixels, params->color);
+}
+
+static void breathe_render(led_color_t *out, size_t pixels,
+                           const led_effect_params_t *params, void *state) {
+  uint32_t phase = params->now_ms % BREATHE_PERIOD_MS;
+  uint32_t half = BREATHE_PERIOD_MS / 2;
+  uint32_t ramp = phase < half ? phase : BREATHE_PERIOD_MS - phase;
+  uint16_t level = led_ease(LED_EASING_IN_OUT, ramp * 0xffff / half);
+  // Never fully dark, the strip would look switched off
+  fill(out, pixels, scale_color(params->color, 16 + (level * 239 >> 16)));
+}
+
+static void rainbow_render(led_color_t *out, size_t pixels,
+                           const led_effect_params_t *params, void *state) {
+  // One full circle of hues along the strip, in 8.8 fixed point
+  uint32_t step = (256 << 8) / pixels;
+  uint32_t hue = (params->now_ms / RAINBOW_MS_PER_HUE) << 8;
+  for (size_t i = 0; i < pixels; i++, hue += step)
+    out[i] = led_hsv_to_rgb((led_hsv_t){.h = hue >> 8, .s = 255, .v = 255});
+}
+
+static void chase_render(led_color_t *out, size_t pixels,
+                         const led_effect_params_t *params, void *state) {
+  size_t head = (params->now_ms / CHASE_MS_PER_STEP) % pixels;
+  for (size_t i = 0; i < pixels; i++) {
+    size_t distance = head >= i ? head - i : head + pixels - i;
+    out[i] = distance < CHASE_TAIL
+                 ? scale_color(params->color,
+                               255 - distance * 255 / CHASE_TAIL)
+                 : (led_color_t){0};
+  }
+}
+
+typedef struct {
+  uint32_t seed;
+  uint32_t last_ms;
+  uint8_t level[];
+} twinkle_state_t;
+
+static size_t twinkle_state_size(size_t pixels) {
+  return sizeof(twinkle_state_t) + pixels;
+}
+
+static void twinkle_init(void *state, size_t pixels) {
+  twinkle_state_t *twinkle = state;
+  twinkle->seed = 0x9e3779b9u ^ pixels;
+}
+
+static void twinkle_render(led_color_t *out, size_t pixels,
+                           const led_effect_params_t *params, void *state) {
+  twinkle_state_t *twinkle = state;
+  uint32_t elapsed = params->now_ms - twinkle->last_ms;
+  twinkle->last_ms = params->now_ms;
+  uint8_t fade = elapsed >= TWINKLE_FADE_MS ? 255
+                                            : elapsed * 255 / TWINKLE_FADE_MS;
+  // About one new star per 64 pixels every frame
+  for (size_t n = pixels / 64 + 1; n > 0; n--) {
+    uint32_t random = xorshift32(&twinkle->seed);
+    if ((random & 3) == 0)
+      twinkle->level[(random >> 8) % pixels] = 255;
+  }
+  for (size_t i = 0; i < pixels; i++) {
+    twinkle->level[i] = qsub8(twinkle->level[i], fade);
+    out[i] = scale_color(params->color, twinkle->level[i]);
+  }
+}
+
+typedef struct {
+  uint32_t seed;
+  uint8_t heat[];
+} fire_state_t;
+
+static size_t fire_state_size(size_t pixels) {
+  return sizeof(fire_state_t) + pixels;
+}
+
+static void fire_init(void *state, size_t pixels) {
+  fire_state_t *fire = state;
+  fire->seed = 0x2545f491u ^ pixels;
+}
+
+/*
+ * Black body palette: black, red, yellow, white
+ */
+static led_color_t heat_color(uint8_t heat) {
+  uint8_t t = heat * 191 / 255;
+  uint8_t ramp = (t & 63) << 2;
+  if (t >= 128)
+    return (led_color_t){.r = 255, .g = 255, .b = ramp};
+  if (t >= 64)
+    return (led_color_t){.r = 255, .g = ramp};
+  return (led_color_t){.r = ramp};
+}
+
+/*
+ * Heat rises from the first pixel and cools down on its way up
+ */
+static void fire_render(led_color_t *out, size_t pixels,
+                        const led_effect_params_t *params, void *state) {
+  fire_state_t *fire = state;
+  uint8_t *heat = fire->heat;
+  uint32_t cooling = FIRE_COOLING * 10 / pixels + 2;
+  for (size_t i = 0; i < pixels; i++)
+    heat[i] = qsub8(heat[i], xorshift32(&fire->seed) % cooling);
+  for (size_t i = pixels - 1; i >= 2; i--)
+    heat[i] = (heat[i - 1] + 2 * heat[i - 2]) / 3;
+  uint32_t random = xorshift32(&fire->seed);
+  if ((random & 0xff) < FIRE_SPARKING) {
+    size_t spark = (random >> 8) % (pixels < 7 ? pixels : 7);
+    heat[spark] = qadd8(heat[spark], 160 + ((random >> 16) % 96));
+  }
+  for (size_t i = 0; i < pixels; i++)
+    out[i] = heat_color(heat[i]);
+}
+
+typedef struct {
+  uint32_t seed;
+  uint16_t level; // 8.8 fixed point
+  uint16_t target;
+} candle_state_t;
+
+static size_t candle_state_size(size_t pixels) {
+  return sizeof(candle_state_t);
+}
+
+static void candle_init(void *state, size_t pixels) {
+  candle_state_t *candle = state;
+  candle->seed = 0x6c078965u ^ pixels;
+  candle->level = candle->target = 224 << 8;
+}
+
+/*
+ * The whole segment flickers together, like one flame
+ */
+static void candle_render(led_color_t *out, size_t pixels,
+                          const led_effect_params_t *params, void *state) {
+  candle_state_t *candle = state;
+  uint32_t random = xorshift32(&candle->seed);
+  if ((random & 7) == 0)
+    candle->target = (160 + ((random >> 8) % 96)) << 8;
+  candle->level += ((int32_t)candle->target - candle->level) / 4;
+  uint8_t jitter = (random >> 16) & 15;
+  fill(out, pixels,
+       scale_color(params->color, qsub8(candle->level >> 8, jitter)));
+}
+
+static const led_effect_t effects[] = {
+    {.name = "solid", .render = solid_render},
+    {.name = "breathe", .animated = 1, .render = breathe_render},
+    {.name = "rainbow", .animated = 1, .render = rainbow_render},
+    {.name = "chase", .animated = 1, .render = chase_render},
+    {.name = "twinkle",
+     .animated = 1,
+     .state_size = twinkle_state_size,
+     .init = twinkle_init,
+     .render = twinkle_render},
+    {.name = "fire",
+     .animated = 1,
+     .state_size = fire_state_size,
+     .init = fire_init,
+     .render = fire_render},
+    {.name = "candle",
+     .animated = 1,
+     .state_size = candle_state_size,
+     .init = candle_init,
+     .render = candle_render},
+};
+#define EFFECT_COUNT (int)(sizeof(effects) / sizeof(effects[0]))
+
+// ns per pixel in 24.8 fixed point, written by the render task only
+static uint32_t effect_costs[EFFECT_COUNT];
+
+int led_effect_count() { return EFFECT_COUNT; }
+
+const led_effect_t *led_effect_get(int index) {
+  return index >= 0 && index < EFFECT_COUNT ? &effects[index] : NULL;
+}
+
+int led_effect_find(const char *name) {
+  for (int i = 0; i < EFFECT_COUNT; i++) {
+    if (!strcmp(effects[i].name, name))
+      return i;
+  }
+  return -1;
+}
+
+int led_effect_prepare(led_effect_instance_t *instance,
+                       const led_effect_t *effect, size_t pixels) {
+  if (instance->effect == effect && instance->pixels == pixels)
+    return 1;
+  led_effect_release(instance);
+  if (!effect || !pixels)
+    return 1;
+  size_t size = effect->state_size ? effect->state_size(pixels) : 0;
+  if (size) {
+    instance->state = calloc(1, size);
+    if (!instance->state)
+      return 0;
+  }
+  if (effect->init)
+    effect->init(instance->state, pixels);
+  instance->effect = effect;
+  instance->pixels = pixels;
+  return 1;
+}
+
+void led_effect_release(led_effect_instance_t *instance) {
+  free(instance->state);
+  *instance = (led_effect_instance_t){0};
+}
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void led_effect_render(led_effect_instance_t *instance, led_color_t *out,
+                       const led_effect_params_t *params) {
+  const led_effect_t *effect = instance->effect;
+  if (!effect)
+    return;
+  uint64_t start = now_ns();
+  effect->render(out, instance->pixels, params, instance->state);
+  uint32_t sample = ((now_ns() - start) << 8) / instance->pixels;
+
+  uint32_t *cost = &effect_costs[effect - effects];
+  if (!*cost)
+    *cost = sample;
+  else
+    *cost += ((int32_t)sample - (int32_t)*cost) >> COST_SMOOTHING;
+}
+
+uint32_t led_effect_cost_ns(int index) {
+  if (index < 0 || index >= EFFECT_COUNT)
+    return 0;
+  return (effect_costs[index] + 128) >> 8;
+}
@@ -0,0 +1,59 @@
+#include "led_layout.h"
+#include <stdlib.h>
+
+static uint16_t physical_index(const led_layout_config_t *config, uint16_t x,
+                               uint16_t y) {
+  if (config->wiring == LED_WIRING_SERPENTINE && (y & 1))
+    x = config->cols - 1 - x;
+  return y * config->cols + x;
+}
+
+int led_layout_init(led_layout_t *layout, const led_layout_config_t *config) {
+  int rotated = config->rotation == LED_ROTATION_90 ||
+                config->rotation == LED_ROTATION_270;
+  uint16_t width = rotated ? config->rows : config->cols;
+  uint16_t height = rotated ? config->cols : config->rows;
+  uint16_t *map = malloc((size_t)width * height * sizeof(uint16_t));
+  if (!map)
+    return 0;
+
+  for (uint16_t y = 0; y < height; y++) {
+    for (uint16_t x = 0; x < width; x++) {
+      uint16_t lx = config->mirror_x ? width - 1 - x : x;
+      uint16_t ly = config->mirror_y ? height - 1 - y : y;
+      uint16_t px, py; // physical column and row
+      switch (config->rotation) {
+      case LED_ROTATION_90:
+        px = ly;
+        py = config->rows - 1 - lx;
+        break;
+      case LED_ROTATION_180:
+        px = config->cols - 1 - lx;
+        py = config->rows - 1 - ly;
+        break;
+      case LED_ROTATION_270:
+        px = config->cols - 1 - ly;
+        py = lx;
+        break;
+      default:
+        px = lx;
+        py = ly;
+        break;
+      }
+      map[y * width + x] = physical_index(config, px, py);
+    }
+  }
+
+  free(layout->map);
+  layout->map = map;
+  layout->width = width;
+  layout->height = height;
+  return 1;
+}
+
+void led_layout_free(led_layout_t *layout) {
+  free(layout->map);
+  layout->map = NULL;
+  layout->width = 0;
+  layout->height = 0;
+}
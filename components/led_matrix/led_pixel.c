@@ -0,0 +1,104 @@
+#include "led_pixel.h"
+#include <string.h>
+
+static inline void store_grb(uint8_t *p, led_color_t c) {
+  p[0] = c.g;
+  p[1] = c.r;
+  p[2] = c.b;
+}
+
+static inline void store_rgb(uint8_t *p, led_color_t c) {
+  p[0] = c.r;
+  p[1] = c.g;
+  p[2] = c.b;
+}
+
+static inline void store_grbw(uint8_t *p, led_color_t c) {
+  p[0] = c.g;
+  p[1] = c.r;
+  p[2] = c.b;
+  p[3] = c.w;
+}
+
+static inline void store_rgbw(uint8_t *p, led_color_t c) {
+  p[0] = c.r;
+  p[1] = c.g;
+  p[2] = c.b;
+  p[3] = c.w;
+}
+
+static inline void store_grb16(uint8_t *p, led_color_t c) {
+  p[0] = p[1] = c.g;
+  p[2] = p[3] = c.r;
+  p[4] = p[5] = c.b;
+}
+
+static inline void store_rgb16(uint8_t *p, led_color_t c) {
+  p[0] = p[1] = c.r;
+  p[2] = p[3] = c.g;
+  p[4] = p[5] = c.b;
+}
+
+/*
+ * set/fill/convert/scatter of one format, the store is inlined into every loop
+ */
+#define LED_PIXEL_FORMAT(fmt, bpp, white)                                      \
+  static void set_##fmt(uint8_t *pixels, int index, led_color_t color) {     \
+    store_##fmt(pixels + index * (bpp), color);                                \
+  }                                                                            \
+  static void fill_##fmt(uint8_t *pixels, size_t count, led_color_t color) {  \
+    if (!count)                                                                \
+      return;                                                                  \
+    store_##fmt(pixels, color);                                                \
+    /* doubling copies of the first pixel */                                   \
+    size_t done = 1;                                                           \
+    while (done < count) {                                                     \
+      size_t n = done < count - done ? done : count - done;                    \
+      memcpy(pixels + done * (bpp), pixels, n * (bpp));                        \
+      done += n;                                                               \
+    }                                                                          \
+  }                                                                            \
+  static void convert_##fmt(uint8_t *pixels, const led_color_t *colors,        \
+                            size_t count) {                                    \
+    for (size_t i = 0; i < count; i++, pixels += (bpp))                        \
+      store_##fmt(pixels, colors[i]);                                          \
+  }                                                                            \
+  static void scatter_##fmt(uint8_t *pixels, const uint16_t *map,            \
+                            const led_color_t *colors, size_t count) {         \
+    for (size_t i = 0; i < count; i++)                                         \
+      store_##fmt(pixels + map[i] * (bpp), colors[i]);                         \
+  }                                                                            \
+  static const led_pixel_ops_t ops_##fmt = {                                   \
+      .name = #fmt,                                                            \
+      .bytes_per_pixel = (bpp),                                                \
+      .has_white = (white),                                                    \
+      .set = set_##fmt,                                                        \
+      .fill = fill_##fmt,                                                      \
+      .convert = convert_##fmt,                                                \
+      .scatter = scatter_##fmt,                                                \
+  };
+
+LED_PIXEL_FORMAT(grb, 3, 0)
+LED_PIXEL_FORMAT(rgb, 3, 0)
+LED_PIXEL_FORMAT(grbw, 4, 1)
+LED_PIXEL_FORMAT(rgbw, 4, 1)
+LED_PIXEL_FORMAT(grb16, 6, 0)
+LED_PIXEL_FORMAT(rgb16, 6, 0)
+
+static const led_pixel_ops_t *const formats[LED_PIXEL_MAX] = {
+    [LED_PIXEL_GRB] = &ops_grb,     [LED_PIXEL_RGB] = &ops_rgb,
+    [LED_PIXEL_GRBW] = &ops_grbw,   [LED_PIXEL_RGBW] = &ops_rgbw,
+    [LED_PIXEL_GRB16] = &ops_grb16, [LED_PIXEL_RGB16] = &ops_rgb16,
+};
+
+const led_pixel_ops_t *led_pixel_ops(led_pixel_format_t format) {
+  return format < LED_PIXEL_MAX ? formats[format] : NULL;
+}
+
+led_pixel_format_t led_pixel_format_from_name(const char *name) {
+  for (int i = 0; i < LED_PIXEL_MAX; i++) {
+    if (!strcmp(formats[i]->name, name))
+      return i;
+  }
+  return LED_PIXEL_MAX;
+}
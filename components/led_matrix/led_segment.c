@@ -0,0 +1,77 @@
+#include "led_segment.h"
+#include <string.h>
+
+static inline uint8_t scale8(uint8_t value, uint8_t scale) {
+  return (value * scale + 127) / 255;
+}
+
+int led_segment_is_valid(const led_segment_t *segment, size_t pixels) {
+  return segment->name[0] &&
+         memchr(segment->name, '\0', sizeof(segment->name)) &&
+         led_effect_get(segment->effect) && segment->length > 0 &&
+         (size_t)segment->start + segment->length <= pixels;
+}
+
+int led_segment_find(const led_segment_t *segments, int count,
+                     const char *name) {
+  for (int i = 0; i < count; i++) {
+    if (!strncmp(segments[i].name, name, sizeof(segments[i].name)))
+      return i;
+  }
+  return -1;
+}
+
+int led_segments_animated(const led_segment_t *segments, int count) {
+  for (int i = 0; i < count; i++) {
+    const led_effect_t *effect = led_effect_get(segments[i].effect);
+    if (effect && effect->animated)
+      return 1;
+  }
+  return 0;
+}
+
+static void scale_span(led_color_t *colors, size_t length, uint8_t scale) {
+  for (size_t i = 0; i < length; i++) {
+    colors[i].r = scale8(colors[i].r, scale);
+    colors[i].g = scale8(colors[i].g, scale);
+    colors[i].b = scale8(colors[i].b, scale);
+    colors[i].w = scale8(colors[i].w, scale);
+  }
+}
+
+static void reverse_span(led_color_t *colors, size_t length) {
+  for (size_t i = 0, j = length - 1; i < j; i++, j--) {
+    led_color_t color = colors[i];
+    colors[i] = colors[j];
+    colors[j] = color;
+  }
+}
+
+void led_segments_render(const led_segment_t *segments,
+                         led_effect_instance_t *effects, int count,
+                         led_color_t *colors, uint8_t *alpha, size_t pixels,
+                         uint32_t now_ms) {
+  memset(alpha, 0, pixels);
+  for (int i = 0; i < count; i++) {
+    const led_segment_t *segment = &segments[i];
+    // The geometry may have shrunk since the segment was set
+    if (segment->start >= pixels)
+      continue;
+    size_t length = segment->length;
+    if (length > pixels - segment->start)
+      length = pixels - segment->start;
+    if (!led_effect_prepare(&effects[i], led_effect_get(segment->effect),
+                            length) ||
+        !effects[i].effect)
+      continue; // no memory for the state, the segment stays transparent
+
+    led_color_t *out = colors + segment->start;
+    led_effect_params_t params = {.color = segment->color, .now_ms = now_ms};
+    led_effect_render(&effects[i], out, &params);
+    if (segment->brightness < 255)
+      scale_span(out, length, segment->brightness);
+    if (segment->reverse)
+      reverse_span(out, length);
+    memset(alpha + segment->start, 255, length);
+  }
+}
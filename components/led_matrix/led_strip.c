@@ -1,63 +1,369 @@
 #include "led_strip.h"
-#include "driver/rmt_tx.h"
+#include "esp_attr.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
-#include "led_strip_encoder.h"
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define RMT_LED_STRIP_RESOLUTION_HZ                                            \
-  10000000 // 10MHz resolution, 1 tick = 0.1us (led strip needs a high
-           // resolution)
 static const char *TAG = "led_strip_component";
 
 /**
- * Global variables
+ * Output channels: the framebuffer is split into one segment per channel,
+ * every frame is queued on all channels and is done when all have sent it
  */
-rmt_channel_handle_t led_chan = NULL;
-rmt_encoder_handle_t led_encoder = NULL;
-rmt_transmit_config_t tx_config = {
-    .loop_count = 0, // no transfer loop
-};
+typedef struct {
+  int frames_in_flight; // framebuffer frames queued on this channel
+  uint32_t frames_done;
+  size_t first_pixel; // segment of the framebuffer
+  size_t pixels;
+} output_channel_t;
+
+static output_channel_t channels[LED_MAX_CHANNELS];
+static int channel_count = 0;
+static led_transport_t *transport = NULL;
+
+/**
+ * Ping-pong framebuffer: the back buffer is rendered while the front one is
+ * on the wire. free_buffers counts the buffers which are not queued in the
+ * transport. Frames complete in the order they were queued, so once it is
+ * taken the oldest queued buffer (the next back buffer) is free again.
+ */
+static uint8_t *framebuffers[2] = {NULL, NULL};
+static size_t framebuffer_size = 0;
+static size_t framebuffer_bpp = 0; // bytes per pixel
+static int back_index = 0;
+static int back_acquired = 0;
+// Encoder payloads, they live as long as the buffer slot is queued
+static led_transport_frame_t frames[2][LED_MAX_CHANNELS];
+/**
+ * Brightness and gamma are applied by the encoder, framebuffers keep the
+ * unscaled colors. Each slot has its own copy of the table, so changing the
+ * levels never affects a frame which is already queued.
+ */
+static uint8_t output_brightness = 255;
+static const uint8_t *output_gamma = NULL;
+static uint8_t slot_levels[2][256];
+/**
+ * Fingerprint of the last queued frame. A frame equal to it is not sent
+ * again, which saves the transport work for effects or clients which resend
+ * static frames.
+ */
+typedef struct {
+  int valid;
+  uint32_t hash; // of the unscaled payload
+  size_t size;
+  uint8_t brightness;
+  const uint8_t *gamma;
+  int is_solid;
+} frame_key_t;
+static frame_key_t last_frame = {0};
+static led_output_stats_t output_stats = {0};
+static struct {
+  int valid;
+  uint8_t brightness;
+  const uint8_t *gamma;
+} slot_levels_key[2];
+static SemaphoreHandle_t free_buffers = NULL;
+// Blocking transmissions share the channels, only framebuffer frames count
+static portMUX_TYPE frames_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t frames_done = 0; // done on every channel
+
+static bool IRAM_ATTR on_frame_done(int channel, void *user_ctx) {
+  output_channel_t *output = &channels[channel];
+  BaseType_t task_woken = pdFALSE;
+  int released = 0;
+  portENTER_CRITICAL_ISR(&frames_lock);
+  if (output->frames_in_flight > 0) {
+    output->frames_in_flight--;
+    output->frames_done++;
+    // The frame is on the wire when the slowest channel has sent it
+    uint32_t done = output->frames_done;
+    for (int i = 0; i < channel_count; i++) {
+      if ((int32_t)(channels[i].frames_done - done) < 0)
+        done = channels[i].frames_done;
+    }
+    released = done != frames_done;
+    frames_done = done;
+  }
+  portEXIT_CRITICAL_ISR(&frames_lock);
+  if (released)
+    xSemaphoreGiveFromISR(free_buffers, &task_woken);
+  return task_woken == pdTRUE;
+}
+
+static void wait_all_channels_done() {
+  for (int i = 0; i < channel_count; i++)
+    ESP_ERROR_CHECK(transport->wait(transport, i));
+}
+
+/*
+ * Splits count pixels evenly between the channels
+ */
+static void split_segments(size_t count) {
+  for (int i = 0; i < channel_count; i++) {
+    channels[i].first_pixel = count * i / channel_count;
+    channels[i].pixels =
+        count * (i + 1) / channel_count - channels[i].first_pixel;
+  }
+}
 
 void transmit_pixels_data(uint8_t *p_pixels, size_t size) {
-  ESP_ERROR_CHECK(
-      rmt_transmit(led_chan, led_encoder, p_pixels, size, &tx_config));
-  ESP_ERROR_CHECK(rmt_tx_wait_all_done(led_chan, portMAX_DELAY));
+  last_frame.valid = 0;
+  led_transport_frame_t payloads[LED_MAX_CHANNELS];
+  for (int i = 0; i < channel_count; i++) {
+    led_frame_t *frame = &payloads[i].pixels;
+    payloads[i].is_solid = 0;
+    frame->levels = NULL;
+    if (framebuffer_bpp) {
+      frame->pixels = p_pixels + channels[i].first_pixel * framebuffer_bpp;
+      frame->size = channels[i].pixels * framebuffer_bpp;
+    } else {
+      // Segments are not known yet, everything goes to the first channel
+      frame->pixels = p_pixels;
+      frame->size = i ? 0 : size;
+    }
+    ESP_ERROR_CHECK(transport->transmit(transport, i, &payloads[i]));
+  }
+  wait_all_channels_done();
 }
 
-void reset_pixels_array(uint8_t *p_pixels, size_t size) {
-  memset(p_pixels, 0, size);
-  ESP_ERROR_CHECK(
-      rmt_transmit(led_chan, led_encoder, p_pixels, size, &tx_config));
-  ESP_ERROR_CHECK(rmt_tx_wait_all_done(led_chan, portMAX_DELAY));
-}
-
-void init_rmt_encoder(int gpio_num) {
-  rmt_tx_channel_config_t tx_chan_config = {
-      .clk_src = 4, // select source clock ?? I don't know what mean that number
-      .gpio_num = gpio_num,
-      .mem_block_symbols =
-          64, // increase the block size can make the LED less flickering
-      .resolution_hz = RMT_LED_STRIP_RESOLUTION_HZ,
-      .trans_queue_depth = 4, // set the number of transactions that can be
-                              // pending in the background
-  };
+void set_output_levels(uint8_t brightness, const uint8_t *gamma) {
+  output_brightness = brightness;
+  output_gamma = gamma;
+}
+
+/*
+ * Levels for the back slot, NULL when the bytes are sent as is
+ */
+static const uint8_t *back_slot_levels() {
+  if (output_brightness == 255 && !output_gamma)
+    return NULL;
+  uint8_t *levels = slot_levels[back_index];
+  if (!slot_levels_key[back_index].valid ||
+      slot_levels_key[back_index].brightness != output_brightness ||
+      slot_levels_key[back_index].gamma != output_gamma) {
+    for (int i = 0; i < 256; i++) {
+      uint8_t value = (i * output_brightness + 127) / 255;
+      levels[i] = output_gamma ? output_gamma[value] : value;
+    }
+    slot_levels_key[back_index].valid = 1;
+    slot_levels_key[back_index].brightness = output_brightness;
+    slot_levels_key[back_index].gamma = output_gamma;
+  }
+  return levels;
+}
+
+void init_framebuffer(size_t pixels, size_t bytes_per_pixel) {
+  size_t size = pixels * bytes_per_pixel;
+  if (framebuffers[0]) {
+    ESP_LOGE(TAG, "Framebuffer is already initiated");
+    return;
+  }
+  framebuffers[0] = calloc(1, size);
+  framebuffers[1] = calloc(1, size);
+  free_buffers = xSemaphoreCreateCounting(2, 2);
+  if (!framebuffers[0] || !framebuffers[1] || !free_buffers) {
+    ESP_LOGE(TAG, "Framebuffer memory allocation error");
+    free(framebuffers[0]);
+    free(framebuffers[1]);
+    framebuffers[0] = framebuffers[1] = NULL;
+    if (free_buffers) {
+      vSemaphoreDelete(free_buffers);
+      free_buffers = NULL;
+    }
+    return;
+  }
+  framebuffer_size = size;
+  framebuffer_bpp = bytes_per_pixel;
+  back_index = 0;
+  split_segments(pixels);
+}
 
-  ESP_ERROR_CHECK(rmt_new_tx_channel(&tx_chan_config, &led_chan));
+int resize_framebuffer(size_t pixels, size_t bytes_per_pixel) {
+  size_t size = pixels * bytes_per_pixel;
+  if (!framebuffers[0])
+    return 0;
+  if (back_acquired) {
+    xSemaphoreGive(free_buffers);
+    back_acquired = 0;
+  }
+  // Both buffers are released by on_frame_done once the queues are drained
+  wait_all_channels_done();
 
-  ESP_LOGI(TAG, "Install led strip encoder");
+  uint8_t *buffers[2] = {calloc(1, size), calloc(1, size)};
+  if (!buffers[0] || !buffers[1]) {
+    ESP_LOGE(TAG, "Framebuffer memory allocation error");
+    free(buffers[0]);
+    free(buffers[1]);
+    return 0;
+  }
+  free(framebuffers[0]);
+  free(framebuffers[1]);
+  framebuffers[0] = buffers[0];
+  framebuffers[1] = buffers[1];
+  framebuffer_size = size;
+  framebuffer_bpp = bytes_per_pixel;
+  back_index = 0;
+  split_segments(pixels);
+  last_frame.valid = 0;
+  return 1;
+}
 
-  led_strip_encoder_config_t encoder_config = {
-      .resolution = RMT_LED_STRIP_RESOLUTION_HZ,
+uint8_t *acquire_back_buffer() {
+  if (!framebuffers[0])
+    return NULL;
+  if (!back_acquired) {
+    // Blocks only while both buffers are queued in the transport
+    xSemaphoreTake(free_buffers, portMAX_DELAY);
+    back_acquired = 1;
+  }
+  return framebuffers[back_index];
+}
+
+static uint32_t hash_bytes(const uint8_t *data, size_t size) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/*
+ * Returns 1 if the frame equals the last queued one, otherwise remembers it
+ */
+static int is_frame_unchanged(int is_solid, const uint8_t *payload,
+                              size_t size) {
+  frame_key_t key = {
+      .valid = 1,
+      .hash = hash_bytes(payload, size),
+      .size = size,
+      .brightness = output_brightness,
+      .gamma = output_gamma,
+      .is_solid = is_solid,
   };
+  if (last_frame.valid && last_frame.hash == key.hash &&
+      last_frame.size == key.size &&
+      last_frame.brightness == key.brightness &&
+      last_frame.gamma == key.gamma && last_frame.is_solid == key.is_solid) {
+    output_stats.frames_skipped++;
+    return 1;
+  }
+  last_frame = key;
+  output_stats.frames_sent++;
+  return 0;
+}
+
+void get_output_stats(led_output_stats_t *stats) { *stats = output_stats; }
+
+/*
+ * Queues the frames of the back slot, one per channel
+ */
+static void queue_back_slot() {
+  portENTER_CRITICAL(&frames_lock);
+  for (int i = 0; i < channel_count; i++)
+    channels[i].frames_in_flight++;
+  portEXIT_CRITICAL(&frames_lock);
+  // Synchronized channels start together once all are queued
+  for (int i = 0; i < channel_count; i++)
+    ESP_ERROR_CHECK(transport->transmit(transport, i, &frames[back_index][i]));
+  back_acquired = 0;
+  back_index ^= 1;
+}
+
+void present_back_buffer() {
+  if (!back_acquired)
+    return;
+  // The slot stays acquired, the next frame is rendered into the same buffer
+  if (is_frame_unchanged(0, framebuffers[back_index], framebuffer_size))
+    return;
+  const uint8_t *levels = back_slot_levels();
+  for (int i = 0; i < channel_count; i++) {
+    led_frame_t *frame = &frames[back_index][i].pixels;
+    frames[back_index][i].is_solid = 0;
+    frame->pixels =
+        framebuffers[back_index] + channels[i].first_pixel * framebuffer_bpp;
+    frame->size = channels[i].pixels * framebuffer_bpp;
+    frame->levels = levels;
+  }
+  queue_back_slot();
+}
+
+void present_solid_color(const uint8_t *pixel, size_t bytes_per_pixel,
+                         size_t count) {
+  led_solid_frame_t solid;
+  if (bytes_per_pixel > sizeof(solid.pixel)) {
+    ESP_LOGE(TAG, "present_solid_color - unsupported pixel size");
+    return;
+  }
+  memset(&solid, 0, sizeof(solid)); // padding is hashed as well
+  memcpy(solid.pixel, pixel, bytes_per_pixel);
+  solid.bytes_per_pixel = bytes_per_pixel;
+  solid.count = count;
+  // A frame which can't be sent must not be remembered as the last one
+  if (!acquire_back_buffer())
+    return;
+  if (is_frame_unchanged(1, (const uint8_t *)&solid, sizeof(solid)))
+    return;
+  solid.levels = back_slot_levels();
+  for (int i = 0; i < channel_count; i++) {
+    frames[back_index][i].is_solid = 1;
+    led_solid_frame_t *frame = &frames[back_index][i].solid;
+    *frame = solid;
+    // Segments of the strip, the same way as the framebuffer is split
+    frame->count = count * (i + 1) / channel_count - count * i / channel_count;
+  }
+  queue_back_slot();
+}
+
+void reset_pixels_array(uint8_t *p_pixels, size_t size) {
+  memset(p_pixels, 0, size);
+  transmit_pixels_data(p_pixels, size);
+}
+
+void init_led_transport(led_transport_t *led_transport, const int *gpio_nums,
+                        int count) {
+  if (transport) {
+    ESP_LOGE(TAG, "LED output is already initiated");
+    return;
+  }
+  ESP_ERROR_CHECK(led_transport->init(led_transport, gpio_nums, count,
+                                      on_frame_done, NULL));
+  transport = led_transport;
+  channel_count = count;
+  split_segments(0);
+}
 
-  ESP_ERROR_CHECK(rmt_new_led_strip_encoder(&encoder_config, &led_encoder));
+void init_led_channels(const int *gpio_nums, int count) {
+  led_transport_t *led_transport = NULL;
+#if CONFIG_LED_TRANSPORT_SPI
+  ESP_ERROR_CHECK(led_new_spi_transport(&led_transport));
+#elif CONFIG_LED_TRANSPORT_HOST
+  led_host_transport_config_t config = {.file = NULL};
+  if (CONFIG_LED_TRANSPORT_HOST_FILE[0]) {
+    config.file = fopen(CONFIG_LED_TRANSPORT_HOST_FILE, "wb");
+    if (!config.file)
+      ESP_LOGE(TAG, "Can't open %s", CONFIG_LED_TRANSPORT_HOST_FILE);
+  }
+  ESP_ERROR_CHECK(led_new_host_transport(&config, &led_transport));
+#else
+  ESP_ERROR_CHECK(led_new_rmt_transport(&led_transport));
+#endif
+  init_led_transport(led_transport, gpio_nums, count);
+}
 
-  ESP_LOGI(TAG, "Enable RMT TX channel");
-  ESP_ERROR_CHECK(rmt_enable(led_chan));
+void deinit_led_transport() {
+  if (!transport)
+    return;
+  wait_all_channels_done();
+  transport->deinit(transport);
+  transport = NULL;
+  channel_count = 0;
 }
 
 void traverse_matrix(uint8_t *p_pixels, led_callback_t callback,
@@ -67,11 +373,26 @@ void traverse_matrix(uint8_t *p_pixels, led_callback_t callback,
     return;
   }
   for (int i = 0; i < led_per_row; i++) {
-    int cell = i * led_per_row;
+    int cell = i * led_per_col;
     for (int j = 0; j < led_per_col; j++) {
       int led = cell + j;
       callback(p_pixels, led);
-      vTaskDelay(pdMS_TO_TICKS(chase_speed));
+      if (chase_speed > 0)
+        vTaskDelay(pdMS_TO_TICKS(chase_speed));
+    }
+  }
+}
+
+void traverse_layout(uint8_t *p_pixels, const led_layout_t *layout,
+                     led_xy_callback_t callback) {
+  if (!p_pixels || !layout->map || !callback) {
+    ESP_LOGE(TAG, "traverse_layout - incorrect parameters were passed");
+    return;
+  }
+  const uint16_t *index = layout->map;
+  for (int y = 0; y < layout->height; y++) {
+    for (int x = 0; x < layout->width; x++) {
+      callback(p_pixels, *index++, x, y);
     }
   }
 }
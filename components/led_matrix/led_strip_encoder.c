@@ -1,13 +1,19 @@
 #include "esp_check.h"
 #include "led_strip_encoder.h"
+#include "led_symbol_lut.h"
 
 static const char *TAG = "led_encoder";
 
+#define LEVELS_CHUNK_SIZE 24 // bytes scaled ahead of the bytes encoder
+
 typedef struct {
     rmt_encoder_t base;
     rmt_encoder_t *bytes_encoder;
     rmt_encoder_t *copy_encoder;
     int state;
+    size_t offset; // frame bytes already encoded through the chunk
+    size_t chunk_size; // scaled bytes in chunk, 0 when it has to be refilled
+    uint8_t chunk[LEVELS_CHUNK_SIZE]; // kept untouched until the bytes encoder completes it
     rmt_symbol_word_t reset_code;
 } rmt_led_strip_encoder_t;
 
@@ -19,15 +25,42 @@ static size_t rmt_encode_led_strip(rmt_encoder_t *encoder, rmt_channel_handle_t
     rmt_encode_state_t session_state = RMT_ENCODING_RESET;
     rmt_encode_state_t state = RMT_ENCODING_RESET;
     size_t encoded_symbols = 0;
+    const led_frame_t *frame = primary_data;
     switch (led_encoder->state) {
     case 0: // send RGB data
-        encoded_symbols += bytes_encoder->encode(bytes_encoder, channel, primary_data, data_size, &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE) {
-            led_encoder->state = 1; // switch to next state when current encoding session finished
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL) {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out; // yield if there's no free space for encoding artifacts
+        if (!frame->levels) {
+            encoded_symbols += bytes_encoder->encode(bytes_encoder, channel, frame->pixels, frame->size, &session_state);
+            if (session_state & RMT_ENCODING_COMPLETE) {
+                led_encoder->state = 1; // switch to next state when current encoding session finished
+            }
+            if (session_state & RMT_ENCODING_MEM_FULL) {
+                state |= RMT_ENCODING_MEM_FULL;
+                goto out; // yield if there's no free space for encoding artifacts
+            }
+        } else {
+            while (led_encoder->offset < frame->size) {
+                if (!led_encoder->chunk_size) {
+                    size_t size = frame->size - led_encoder->offset;
+                    if (size > LEVELS_CHUNK_SIZE) {
+                        size = LEVELS_CHUNK_SIZE;
+                    }
+                    const uint8_t *src = frame->pixels + led_encoder->offset;
+                    for (size_t i = 0; i < size; i++) {
+                        led_encoder->chunk[i] = frame->levels[src[i]];
+                    }
+                    led_encoder->chunk_size = size;
+                }
+                encoded_symbols += bytes_encoder->encode(bytes_encoder, channel, led_encoder->chunk, led_encoder->chunk_size, &session_state);
+                if (session_state & RMT_ENCODING_COMPLETE) {
+                    led_encoder->offset += led_encoder->chunk_size;
+                    led_encoder->chunk_size = 0;
+                }
+                if (session_state & RMT_ENCODING_MEM_FULL) {
+                    state |= RMT_ENCODING_MEM_FULL;
+                    goto out; // yield if there's no free space for encoding artifacts
+                }
+            }
+            led_encoder->state = 1;
         }
     // fall-through
     case 1: // send reset code
@@ -35,6 +68,8 @@ static size_t rmt_encode_led_strip(rmt_encoder_t *encoder, rmt_channel_handle_t
                                                 sizeof(led_encoder->reset_code), &session_state);
         if (session_state & RMT_ENCODING_COMPLETE) {
             led_encoder->state = RMT_ENCODING_RESET; // back to the initial encoding session
+            led_encoder->offset = 0;
+            led_encoder->chunk_size = 0;
             state |= RMT_ENCODING_COMPLETE;
         }
         if (session_state & RMT_ENCODING_MEM_FULL) {
@@ -62,46 +97,206 @@ static esp_err_t rmt_led_strip_encoder_reset(rmt_encoder_t *encoder)
     rmt_encoder_reset(led_encoder->bytes_encoder);
     rmt_encoder_reset(led_encoder->copy_encoder);
     led_encoder->state = RMT_ENCODING_RESET;
+    led_encoder->offset = 0;
+    led_encoder->chunk_size = 0;
     return ESP_OK;
 }
 
-esp_err_t rmt_new_led_strip_encoder(const led_strip_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+static void led_strip_bit_symbols(const led_strip_encoder_config_t *config, rmt_symbol_word_t *bit0, rmt_symbol_word_t *bit1)
 {
-    esp_err_t ret = ESP_OK;
-    rmt_led_strip_encoder_t *led_encoder = NULL;
-    ESP_GOTO_ON_FALSE(config && ret_encoder, ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
-    led_encoder = calloc(1, sizeof(rmt_led_strip_encoder_t));
-    ESP_GOTO_ON_FALSE(led_encoder, ESP_ERR_NO_MEM, err, TAG, "no mem for led strip encoder");
-    led_encoder->base.encode = rmt_encode_led_strip;
-    led_encoder->base.del = rmt_del_led_strip_encoder;
-    led_encoder->base.reset = rmt_led_strip_encoder_reset;
     // different led strip might have its own timing requirements, following parameter is for WS2812
+    *bit0 = (rmt_symbol_word_t) {
+        .level0 = 1,
+        .duration0 = 0.3 * config->resolution / 1000000, // T0H=0.3us
+        .level1 = 0,
+        .duration1 = 0.9 * config->resolution / 1000000, // T0L=0.9us
+    };
+    *bit1 = (rmt_symbol_word_t) {
+        .level0 = 1,
+        .duration0 = 0.9 * config->resolution / 1000000, // T1H=0.9us
+        .level1 = 0,
+        .duration1 = 0.3 * config->resolution / 1000000, // T1L=0.3us
+    };
+}
+
+static esp_err_t led_strip_new_sub_encoders(const led_strip_encoder_config_t *config, rmt_encoder_handle_t *ret_bytes, rmt_encoder_handle_t *ret_copy)
+{
+    esp_err_t ret = ESP_OK;
     rmt_bytes_encoder_config_t bytes_encoder_config = {
-        .bit0 = {
-            .level0 = 1,
-            .duration0 = 0.3 * config->resolution / 1000000, // T0H=0.3us
-            .level1 = 0,
-            .duration1 = 0.9 * config->resolution / 1000000, // T0L=0.9us
-        },
-        .bit1 = {
-            .level0 = 1,
-            .duration0 = 0.9 * config->resolution / 1000000, // T1H=0.9us
-            .level1 = 0,
-            .duration1 = 0.3 * config->resolution / 1000000, // T1L=0.3us
-        },
         .flags.msb_first = 1 // WS2812 transfer bit order: G7...G0R7...R0B7...B0
     };
-    ESP_GOTO_ON_ERROR(rmt_new_bytes_encoder(&bytes_encoder_config, &led_encoder->bytes_encoder), err, TAG, "create bytes encoder failed");
+    led_strip_bit_symbols(config, &bytes_encoder_config.bit0, &bytes_encoder_config.bit1);
+    ESP_GOTO_ON_ERROR(rmt_new_bytes_encoder(&bytes_encoder_config, ret_bytes), err, TAG, "create bytes encoder failed");
     rmt_copy_encoder_config_t copy_encoder_config = {};
-    ESP_GOTO_ON_ERROR(rmt_new_copy_encoder(&copy_encoder_config, &led_encoder->copy_encoder), err, TAG, "create copy encoder failed");
+    ESP_GOTO_ON_ERROR(rmt_new_copy_encoder(&copy_encoder_config, ret_copy), err, TAG, "create copy encoder failed");
+
+    return ESP_OK;
+err:
+    if (*ret_bytes) {
+        rmt_del_encoder(*ret_bytes);
+        *ret_bytes = NULL;
+    }
+    return ret;
+}
 
+static rmt_symbol_word_t led_strip_reset_code(const led_strip_encoder_config_t *config)
+{
     uint32_t reset_ticks = config->resolution / 1000000 * 50 / 2; // reset code duration defaults to 50us
-    led_encoder->reset_code = (rmt_symbol_word_t) {
+    return (rmt_symbol_word_t) {
         .level0 = 0,
         .duration0 = reset_ticks,
         .level1 = 0,
         .duration1 = reset_ticks,
     };
+}
+
+typedef struct led_shared_lut {
+    struct led_shared_lut *next;
+    uint32_t bit0;
+    uint32_t bit1;
+    int refs; // encoders using the table
+    led_symbol_lut_t lut;
+} led_shared_lut_t;
+
+// Channels share the bit timings, so they share one 8 KB table instead of one each.
+// Encoders are created and deleted by one task at a time.
+static led_shared_lut_t *s_shared_luts = NULL;
+
+static led_shared_lut_t *led_shared_lut_get(uint32_t bit0, uint32_t bit1)
+{
+    for (led_shared_lut_t *shared = s_shared_luts; shared; shared = shared->next) {
+        if (shared->bit0 == bit0 && shared->bit1 == bit1) {
+            shared->refs++;
+            return shared;
+        }
+    }
+    led_shared_lut_t *shared = malloc(sizeof(led_shared_lut_t));
+    if (!shared) {
+        return NULL;
+    }
+    shared->bit0 = bit0;
+    shared->bit1 = bit1;
+    shared->refs = 1;
+    led_symbol_lut_init(&shared->lut, bit0, bit1);
+    shared->next = s_shared_luts;
+    s_shared_luts = shared;
+    return shared;
+}
+
+static void led_shared_lut_put(led_shared_lut_t *shared)
+{
+    if (--shared->refs) {
+        return;
+    }
+    for (led_shared_lut_t **link = &s_shared_luts; *link; link = &(*link)->next) {
+        if (*link == shared) {
+            *link = shared->next;
+            break;
+        }
+    }
+    free(shared);
+}
+
+typedef struct {
+    rmt_encoder_t base;
+    rmt_encoder_t *simple_encoder;
+    rmt_symbol_word_t reset_code;
+    led_shared_lut_t *lut;
+} rmt_led_lut_encoder_t;
+
+static size_t rmt_encode_led_lut_cb(const void *data, size_t data_size, size_t symbols_written, size_t symbols_free,
+                                    rmt_symbol_word_t *symbols, bool *done, void *arg)
+{
+    rmt_led_lut_encoder_t *led_encoder = arg;
+    const led_frame_t *frame = data;
+    size_t data_symbols = frame->size * 8;
+    if (symbols_written < data_symbols) {
+        // only whole bytes are written, so symbols_written is always a multiple of 8
+        size_t offset = symbols_written / 8;
+        size_t bytes = symbols_free / 8;
+        if (bytes > frame->size - offset) {
+            bytes = frame->size - offset;
+        }
+        if (frame->levels) {
+            led_symbol_lut_encode_levels(&led_encoder->lut->lut, frame->levels, frame->pixels + offset, bytes, (uint32_t *)symbols);
+        } else {
+            led_symbol_lut_encode(&led_encoder->lut->lut, frame->pixels + offset, bytes, (uint32_t *)symbols);
+        }
+        return bytes * 8;
+    }
+    if (symbols_free < 1) {
+        return 0;
+    }
+    symbols[0] = led_encoder->reset_code;
+    *done = true;
+    return 1;
+}
+
+static size_t rmt_encode_led_lut(rmt_encoder_t *encoder, rmt_channel_handle_t channel, const void *primary_data, size_t data_size, rmt_encode_state_t *ret_state)
+{
+    rmt_led_lut_encoder_t *led_encoder = __containerof(encoder, rmt_led_lut_encoder_t, base);
+    return led_encoder->simple_encoder->encode(led_encoder->simple_encoder, channel, primary_data, data_size, ret_state);
+}
+
+static esp_err_t rmt_del_led_lut_encoder(rmt_encoder_t *encoder)
+{
+    rmt_led_lut_encoder_t *led_encoder = __containerof(encoder, rmt_led_lut_encoder_t, base);
+    rmt_del_encoder(led_encoder->simple_encoder);
+    led_shared_lut_put(led_encoder->lut);
+    free(led_encoder);
+    return ESP_OK;
+}
+
+static esp_err_t rmt_led_lut_encoder_reset(rmt_encoder_t *encoder)
+{
+    rmt_led_lut_encoder_t *led_encoder = __containerof(encoder, rmt_led_lut_encoder_t, base);
+    return rmt_encoder_reset(led_encoder->simple_encoder);
+}
+
+static esp_err_t rmt_new_led_lut_encoder(const led_strip_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+{
+    esp_err_t ret = ESP_OK;
+    rmt_led_lut_encoder_t *led_encoder = calloc(1, sizeof(rmt_led_lut_encoder_t));
+    ESP_GOTO_ON_FALSE(led_encoder, ESP_ERR_NO_MEM, err, TAG, "no mem for led lut encoder");
+    led_encoder->base.encode = rmt_encode_led_lut;
+    led_encoder->base.del = rmt_del_led_lut_encoder;
+    led_encoder->base.reset = rmt_led_lut_encoder_reset;
+    rmt_symbol_word_t bit0, bit1;
+    led_strip_bit_symbols(config, &bit0, &bit1);
+    led_encoder->lut = led_shared_lut_get(bit0.val, bit1.val);
+    ESP_GOTO_ON_FALSE(led_encoder->lut, ESP_ERR_NO_MEM, err, TAG, "no mem for led symbol table");
+    led_encoder->reset_code = led_strip_reset_code(config);
+    rmt_simple_encoder_config_t simple_encoder_config = {
+        .callback = rmt_encode_led_lut_cb,
+        .arg = led_encoder,
+        .min_chunk_size = 8, // symbols of one byte
+    };
+    ESP_GOTO_ON_ERROR(rmt_new_simple_encoder(&simple_encoder_config, &led_encoder->simple_encoder), err, TAG, "create simple encoder failed");
+    *ret_encoder = &led_encoder->base;
+    return ESP_OK;
+err:
+    if (led_encoder && led_encoder->lut) {
+        led_shared_lut_put(led_encoder->lut);
+    }
+    free(led_encoder);
+    return ret;
+}
+
+esp_err_t rmt_new_led_strip_encoder(const led_strip_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+{
+    esp_err_t ret = ESP_OK;
+    rmt_led_strip_encoder_t *led_encoder = NULL;
+    ESP_GOTO_ON_FALSE(config && ret_encoder, ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
+    if (config->type == LED_STRIP_ENCODER_LUT) {
+        return rmt_new_led_lut_encoder(config, ret_encoder);
+    }
+    led_encoder = calloc(1, sizeof(rmt_led_strip_encoder_t));
+    ESP_GOTO_ON_FALSE(led_encoder, ESP_ERR_NO_MEM, err, TAG, "no mem for led strip encoder");
+    led_encoder->base.encode = rmt_encode_led_strip;
+    led_encoder->base.del = rmt_del_led_strip_encoder;
+    led_encoder->base.reset = rmt_led_strip_encoder_reset;
+    ESP_GOTO_ON_ERROR(led_strip_new_sub_encoders(config, &led_encoder->bytes_encoder, &led_encoder->copy_encoder), err, TAG, "create sub encoders failed");
+    led_encoder->reset_code = led_strip_reset_code(config);
     *ret_encoder = &led_encoder->base;
     return ESP_OK;
 err:
@@ -116,3 +311,99 @@ err:
     }
     return ret;
 }
+
+typedef struct {
+    rmt_encoder_t base;
+    rmt_encoder_t *bytes_encoder;
+    rmt_encoder_t *copy_encoder;
+    int state;
+    uint32_t repeated; // pixels already encoded in the current frame
+    uint8_t pixel[LED_MAX_BYTES_PER_PIXEL]; // frame pixel with levels applied
+    rmt_symbol_word_t reset_code;
+} rmt_led_solid_encoder_t;
+
+static size_t rmt_encode_led_solid(rmt_encoder_t *encoder, rmt_channel_handle_t channel, const void *primary_data, size_t data_size, rmt_encode_state_t *ret_state)
+{
+    rmt_led_solid_encoder_t *led_encoder = __containerof(encoder, rmt_led_solid_encoder_t, base);
+    const led_solid_frame_t *frame = primary_data;
+    rmt_encoder_handle_t bytes_encoder = led_encoder->bytes_encoder;
+    rmt_encoder_handle_t copy_encoder = led_encoder->copy_encoder;
+    rmt_encode_state_t session_state = RMT_ENCODING_RESET;
+    rmt_encode_state_t state = RMT_ENCODING_RESET;
+    size_t encoded_symbols = 0;
+    switch (led_encoder->state) {
+    case 0: // send the same pixel frame->count times
+        if (!led_encoder->repeated) {
+            // the frame is not changed while queued, refilling on a resumed first pixel is harmless
+            for (int i = 0; i < frame->bytes_per_pixel; i++) {
+                led_encoder->pixel[i] = frame->levels ? frame->levels[frame->pixel[i]] : frame->pixel[i];
+            }
+        }
+        while (led_encoder->repeated < frame->count) {
+            // bytes encoder rewinds itself once the pixel is complete
+            encoded_symbols += bytes_encoder->encode(bytes_encoder, channel, led_encoder->pixel, frame->bytes_per_pixel, &session_state);
+            if (session_state & RMT_ENCODING_COMPLETE) {
+                led_encoder->repeated++;
+            }
+            if (session_state & RMT_ENCODING_MEM_FULL) {
+                state |= RMT_ENCODING_MEM_FULL;
+                goto out; // yield if there's no free space for encoding artifacts
+            }
+        }
+        led_encoder->state = 1;
+    // fall-through
+    case 1: // send reset code
+        encoded_symbols += copy_encoder->encode(copy_encoder, channel, &led_encoder->reset_code,
+                                                sizeof(led_encoder->reset_code), &session_state);
+        if (session_state & RMT_ENCODING_COMPLETE) {
+            led_encoder->state = RMT_ENCODING_RESET; // back to the initial encoding session
+            led_encoder->repeated = 0;
+            state |= RMT_ENCODING_COMPLETE;
+        }
+        if (session_state & RMT_ENCODING_MEM_FULL) {
+            state |= RMT_ENCODING_MEM_FULL;
+            goto out; // yield if there's no free space for encoding artifacts
+        }
+    }
+out:
+    *ret_state = state;
+    return encoded_symbols;
+}
+
+static esp_err_t rmt_del_led_solid_encoder(rmt_encoder_t *encoder)
+{
+    rmt_led_solid_encoder_t *led_encoder = __containerof(encoder, rmt_led_solid_encoder_t, base);
+    rmt_del_encoder(led_encoder->bytes_encoder);
+    rmt_del_encoder(led_encoder->copy_encoder);
+    free(led_encoder);
+    return ESP_OK;
+}
+
+static esp_err_t rmt_led_solid_encoder_reset(rmt_encoder_t *encoder)
+{
+    rmt_led_solid_encoder_t *led_encoder = __containerof(encoder, rmt_led_solid_encoder_t, base);
+    rmt_encoder_reset(led_encoder->bytes_encoder);
+    rmt_encoder_reset(led_encoder->copy_encoder);
+    led_encoder->state = RMT_ENCODING_RESET;
+    led_encoder->repeated = 0;
+    return ESP_OK;
+}
+
+esp_err_t rmt_new_led_solid_encoder(const led_strip_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+{
+    esp_err_t ret = ESP_OK;
+    rmt_led_solid_encoder_t *led_encoder = NULL;
+    ESP_GOTO_ON_FALSE(config && ret_encoder, ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
+    led_encoder = calloc(1, sizeof(rmt_led_solid_encoder_t));
+    ESP_GOTO_ON_FALSE(led_encoder, ESP_ERR_NO_MEM, err, TAG, "no mem for led solid encoder");
+    led_encoder->base.encode = rmt_encode_led_solid;
+    led_encoder->base.del = rmt_del_led_solid_encoder;
+    led_encoder->base.reset = rmt_led_solid_encoder_reset;
+    ESP_GOTO_ON_ERROR(led_strip_new_sub_encoders(config, &led_encoder->bytes_encoder, &led_encoder->copy_encoder), err, TAG, "create sub encoders failed");
+    led_encoder->reset_code = led_strip_reset_code(config);
+    *ret_encoder = &led_encoder->base;
+    return ESP_OK;
+err:
+    free(led_encoder);
+    return ret;
+}
@@ -0,0 +1,37 @@
+#include "led_symbol_lut.h"
+#include <string.h>
+
+void led_symbol_lut_init(led_symbol_lut_t *lut, uint32_t bit0, uint32_t bit1) {
+  for (int value = 0; value < 256; value++) {
+    for (int bit = 0; bit < 8; bit++) {
+      // WS2812 transfer bit order is MSB first
+      lut->symbols[value][bit] = (value & (0x80 >> bit)) ? bit1 : bit0;
+    }
+  }
+}
+
+void led_symbol_lut_encode(const led_symbol_lut_t *lut, const uint8_t *src,
+                           size_t size, uint32_t *dst) {
+  for (size_t i = 0; i < size; i++) {
+    memcpy(dst, lut->symbols[src[i]], sizeof(lut->symbols[0]));
+    dst += 8;
+  }
+}
+
+void led_symbol_lut_encode_levels(const led_symbol_lut_t *lut,
+                                  const uint8_t *levels, const uint8_t *src,
+                                  size_t size, uint32_t *dst) {
+  for (size_t i = 0; i < size; i++) {
+    memcpy(dst, lut->symbols[levels[src[i]]], sizeof(lut->symbols[0]));
+    dst += 8;
+  }
+}
+
+void led_symbol_bitwise_encode(uint32_t bit0, uint32_t bit1,
+                               const uint8_t *src, size_t size, uint32_t *dst) {
+  for (size_t i = 0; i < size; i++) {
+    for (int bit = 7; bit >= 0; bit--) {
+      *dst++ = (src[i] & (1 << bit)) ? bit1 : bit0;
+    }
+  }
+}
@@ -0,0 +1,60 @@
+#include "led_transition.h"
+
+uint16_t led_ease(led_easing_t easing, uint16_t progress) {
+  uint32_t p = progress;
+  switch (easing) {
+  case LED_EASING_IN:
+    return (p * p) >> 16;
+  case LED_EASING_OUT: {
+    uint32_t rest = 0xffff - p;
+    return 0xffff - ((rest * rest) >> 16);
+  }
+  case LED_EASING_IN_OUT: {
+    // smoothstep: p^2 * (3 - 2p)
+    uint32_t square = (p * p) >> 16;
+    return ((uint64_t)square * (3 * 0xffff - 2 * p)) >> 16;
+  }
+  default:
+    return progress;
+  }
+}
+
+void led_transition_set(led_transition_t *transition, uint16_t value) {
+  transition->from = value;
+  transition->to = value;
+  transition->value = value;
+  transition->duration_ms = 0;
+}
+
+void led_transition_start(led_transition_t *transition, uint16_t target,
+                          uint32_t duration_ms, led_easing_t easing,
+                          uint32_t now_ms) {
+  if (!duration_ms || transition->value == target) {
+    led_transition_set(transition, target);
+    return;
+  }
+  transition->from = transition->value;
+  transition->to = target;
+  transition->easing = easing;
+  transition->start_ms = now_ms;
+  transition->duration_ms = duration_ms;
+}
+
+uint16_t led_transition_step(led_transition_t *transition, uint32_t now_ms) {
+  if (!led_transition_active(transition))
+    return transition->value;
+
+  uint32_t elapsed = now_ms - transition->start_ms;
+  if (elapsed >= transition->duration_ms) {
+    led_transition_set(transition, transition->to);
+    return transition->value;
+  }
+  uint16_t progress =
+      ((uint64_t)elapsed << 16) / transition->duration_ms; // < 0x10000
+  int32_t delta = (int32_t)transition->to - transition->from;
+  transition->value =
+      transition->from +
+      (int32_t)(((int64_t)delta * led_ease(transition->easing, progress)) >>
+                16);
+  return transition->value;
+}
@@ -0,0 +1,124 @@
+#include "esp_check.h"
+#include "led_transport.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "led_transport_host";
+
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+} host_led_frame_t;
+
+typedef struct {
+  led_transport_t base;
+  int count;
+  FILE *file;
+  led_transport_done_cb_t on_done;
+  void *user_ctx;
+  host_led_frame_t frames[LED_MAX_CHANNELS]; // last one of every channel
+} host_led_transport_t;
+
+static void host_led_render(uint8_t *out, const uint8_t *bytes, size_t size,
+                            const uint8_t *levels) {
+  if (!levels) {
+    memcpy(out, bytes, size);
+    return;
+  }
+  for (size_t i = 0; i < size; i++)
+    out[i] = levels[bytes[i]];
+}
+
+static esp_err_t host_led_init(led_transport_t *transport,
+                               const int *gpio_nums, int count,
+                               led_transport_done_cb_t on_done,
+                               void *user_ctx) {
+  host_led_transport_t *host =
+      __containerof(transport, host_led_transport_t, base);
+  ESP_RETURN_ON_FALSE(count > 0 && count <= LED_MAX_CHANNELS && on_done,
+                      ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+  host->count = count;
+  host->on_done = on_done;
+  host->user_ctx = user_ctx;
+  return ESP_OK;
+}
+
+static esp_err_t host_led_transmit(led_transport_t *transport, int channel,
+                                   const led_transport_frame_t *frame) {
+  host_led_transport_t *host =
+      __containerof(transport, host_led_transport_t, base);
+  host_led_frame_t *record = &host->frames[channel];
+  size_t size = frame->is_solid
+                    ? frame->solid.count * frame->solid.bytes_per_pixel
+                    : frame->pixels.size;
+  if (record->capacity < size) {
+    uint8_t *data = realloc(record->data, size);
+    ESP_RETURN_ON_FALSE(data, ESP_ERR_NO_MEM, TAG, "no mem for host frame");
+    record->data = data;
+    record->capacity = size;
+  }
+  record->size = size;
+
+  if (frame->is_solid) {
+    const led_solid_frame_t *solid = &frame->solid;
+    for (uint32_t i = 0; i < solid->count; i++)
+      host_led_render(record->data + i * solid->bytes_per_pixel, solid->pixel,
+                      solid->bytes_per_pixel, solid->levels);
+  } else {
+    host_led_render(record->data, frame->pixels.pixels, frame->pixels.size,
+                    frame->pixels.levels);
+  }
+
+  if (host->file) {
+    uint32_t header[2] = {channel, size};
+    ESP_RETURN_ON_FALSE(fwrite(header, sizeof(header), 1, host->file) == 1 &&
+                            fwrite(record->data, 1, size, host->file) == size,
+                        ESP_FAIL, TAG, "write frame failed");
+  }
+  // Nothing is queued, the frame is done already
+  host->on_done(channel, host->user_ctx);
+  return ESP_OK;
+}
+
+static esp_err_t host_led_wait(led_transport_t *transport, int channel) {
+  host_led_transport_t *host =
+      __containerof(transport, host_led_transport_t, base);
+  if (host->file)
+    fflush(host->file);
+  return ESP_OK;
+}
+
+static esp_err_t host_led_deinit(led_transport_t *transport) {
+  host_led_transport_t *host =
+      __containerof(transport, host_led_transport_t, base);
+  for (int i = 0; i < LED_MAX_CHANNELS; i++)
+    free(host->frames[i].data);
+  if (host->file)
+    fflush(host->file);
+  free(host);
+  return ESP_OK;
+}
+
+esp_err_t led_new_host_transport(const led_host_transport_config_t *config,
+                                 led_transport_t **ret_transport) {
+  ESP_RETURN_ON_FALSE(config && ret_transport, ESP_ERR_INVALID_ARG, TAG,
+                      "invalid argument");
+  host_led_transport_t *host = calloc(1, sizeof(host_led_transport_t));
+  ESP_RETURN_ON_FALSE(host, ESP_ERR_NO_MEM, TAG, "no mem for host transport");
+  host->file = config->file;
+  host->base.init = host_led_init;
+  host->base.transmit = host_led_transmit;
+  host->base.wait = host_led_wait;
+  host->base.deinit = host_led_deinit;
+  *ret_transport = &host->base;
+  return ESP_OK;
+}
+
+const uint8_t *led_host_transport_frame(led_transport_t *transport,
+                                        int channel, size_t *size) {
+  host_led_transport_t *host =
+      __containerof(transport, host_led_transport_t, base);
+  *size = host->frames[channel].size;
+  return host->frames[channel].data;
+}
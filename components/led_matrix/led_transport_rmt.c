@@ -0,0 +1,176 @@
+#include "driver/rmt_tx.h"
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "led_strip_encoder.h"
+#include "led_transport.h"
+#include "soc/soc_caps.h"
+#include <stdlib.h>
+
+#define RMT_LED_STRIP_RESOLUTION_HZ                                            \
+  10000000 // 10MHz resolution, 1 tick = 0.1us (led strip needs a high
+           // resolution)
+static const char *TAG = "led_transport_rmt";
+
+typedef struct rmt_led_transport_t rmt_led_transport_t;
+
+typedef struct {
+  rmt_led_transport_t *transport;
+  int index;
+  rmt_channel_handle_t chan;
+  rmt_encoder_handle_t encoder; // encoders keep state, one per channel
+  rmt_encoder_handle_t solid_encoder;
+} rmt_led_channel_t;
+
+struct rmt_led_transport_t {
+  led_transport_t base;
+  rmt_led_channel_t channels[LED_MAX_CHANNELS];
+  int count;
+  rmt_sync_manager_handle_t sync_manager;
+  led_transport_done_cb_t on_done;
+  void *user_ctx;
+};
+
+static const rmt_transmit_config_t tx_config = {
+    .loop_count = 0, // no transfer loop
+};
+
+static bool IRAM_ATTR rmt_led_on_trans_done(
+    rmt_channel_handle_t channel, const rmt_tx_done_event_data_t *edata,
+    void *user_ctx) {
+  rmt_led_channel_t *output = user_ctx;
+  return output->transport->on_done(output->index,
+                                    output->transport->user_ctx);
+}
+
+static esp_err_t rmt_led_deinit(led_transport_t *transport) {
+  rmt_led_transport_t *rmt =
+      __containerof(transport, rmt_led_transport_t, base);
+#if SOC_RMT_SUPPORT_TX_SYNCHRO
+  if (rmt->sync_manager)
+    rmt_del_sync_manager(rmt->sync_manager);
+#endif
+  for (int i = 0; i < LED_MAX_CHANNELS; i++) {
+    rmt_led_channel_t *output = &rmt->channels[i];
+    if (output->chan) {
+      rmt_disable(output->chan);
+      rmt_del_channel(output->chan);
+    }
+    if (output->encoder)
+      rmt_del_encoder(output->encoder);
+    if (output->solid_encoder)
+      rmt_del_encoder(output->solid_encoder);
+  }
+  free(rmt);
+  return ESP_OK;
+}
+
+static esp_err_t rmt_led_init(led_transport_t *transport, const int *gpio_nums,
+                              int count, led_transport_done_cb_t on_done,
+                              void *user_ctx) {
+  rmt_led_transport_t *rmt =
+      __containerof(transport, rmt_led_transport_t, base);
+  ESP_RETURN_ON_FALSE(count > 0 && count <= LED_MAX_CHANNELS && on_done,
+                      ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+  ESP_RETURN_ON_FALSE(!rmt->count, ESP_ERR_INVALID_STATE, TAG,
+                      "channels are already initiated");
+  rmt->on_done = on_done;
+  rmt->user_ctx = user_ctx;
+
+  led_strip_encoder_config_t encoder_config = {
+      .resolution = RMT_LED_STRIP_RESOLUTION_HZ,
+#if CONFIG_LED_STRIP_ENCODER_LUT
+      .type = LED_STRIP_ENCODER_LUT,
+#else
+      .type = LED_STRIP_ENCODER_BYTES,
+#endif
+  };
+  rmt_tx_event_callbacks_t cbs = {
+      .on_trans_done = rmt_led_on_trans_done,
+  };
+  rmt_channel_handle_t handles[LED_MAX_CHANNELS];
+
+  for (int i = 0; i < count; i++) {
+    rmt_led_channel_t *output = &rmt->channels[i];
+    output->transport = rmt;
+    output->index = i;
+    rmt_tx_channel_config_t tx_chan_config = {
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .gpio_num = gpio_nums[i],
+        .mem_block_symbols =
+            64, // increase the block size can make the LED less flickering
+        .resolution_hz = RMT_LED_STRIP_RESOLUTION_HZ,
+        .trans_queue_depth = 4, // set the number of transactions that can be
+                                // pending in the background
+    };
+    ESP_RETURN_ON_ERROR(rmt_new_tx_channel(&tx_chan_config, &output->chan),
+                        TAG, "create RMT channel failed");
+    handles[i] = output->chan;
+
+    ESP_LOGI(TAG, "Install led strip encoder for GPIO %d", gpio_nums[i]);
+    ESP_RETURN_ON_ERROR(
+        rmt_new_led_strip_encoder(&encoder_config, &output->encoder), TAG,
+        "create led strip encoder failed");
+    ESP_RETURN_ON_ERROR(
+        rmt_new_led_solid_encoder(&encoder_config, &output->solid_encoder),
+        TAG, "create led solid encoder failed");
+    ESP_RETURN_ON_ERROR(
+        rmt_tx_register_event_callbacks(output->chan, &cbs, output), TAG,
+        "register callbacks failed");
+  }
+  rmt->count = count;
+
+  ESP_LOGI(TAG, "Enable RMT TX channels");
+  for (int i = 0; i < count; i++)
+    ESP_RETURN_ON_ERROR(rmt_enable(rmt->channels[i].chan), TAG,
+                        "enable RMT channel failed");
+
+#if SOC_RMT_SUPPORT_TX_SYNCHRO
+  if (count > 1) {
+    rmt_sync_manager_config_t sync_config = {
+        .tx_channel_array = handles,
+        .array_size = count,
+    };
+    ESP_RETURN_ON_ERROR(
+        rmt_new_sync_manager(&sync_config, &rmt->sync_manager), TAG,
+        "create sync manager failed");
+  }
+#else
+  // No hardware sync (ESP32): channels are started back to back, a few
+  // microseconds apart
+  (void)handles;
+#endif
+  return ESP_OK;
+}
+
+static esp_err_t rmt_led_transmit(led_transport_t *transport, int channel,
+                                  const led_transport_frame_t *frame) {
+  rmt_led_transport_t *rmt =
+      __containerof(transport, rmt_led_transport_t, base);
+  rmt_led_channel_t *output = &rmt->channels[channel];
+  if (frame->is_solid)
+    return rmt_transmit(output->chan, output->solid_encoder, &frame->solid,
+                        sizeof(frame->solid), &tx_config);
+  return rmt_transmit(output->chan, output->encoder, &frame->pixels,
+                      sizeof(frame->pixels), &tx_config);
+}
+
+static esp_err_t rmt_led_wait(led_transport_t *transport, int channel) {
+  rmt_led_transport_t *rmt =
+      __containerof(transport, rmt_led_transport_t, base);
+  return rmt_tx_wait_all_done(rmt->channels[channel].chan, portMAX_DELAY);
+}
+
+esp_err_t led_new_rmt_transport(led_transport_t **ret_transport) {
+  ESP_RETURN_ON_FALSE(ret_transport, ESP_ERR_INVALID_ARG, TAG,
+                      "invalid argument");
+  rmt_led_transport_t *rmt = calloc(1, sizeof(rmt_led_transport_t));
+  ESP_RETURN_ON_FALSE(rmt, ESP_ERR_NO_MEM, TAG, "no mem for rmt transport");
+  rmt->base.init = rmt_led_init;
+  rmt->base.transmit = rmt_led_transmit;
+  rmt->base.wait = rmt_led_wait;
+  rmt->base.deinit = rmt_led_deinit;
+  *ret_transport = &rmt->base;
+  return ESP_OK;
+}
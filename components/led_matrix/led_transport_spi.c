@@ -0,0 +1,255 @@
+#include "driver/spi_master.h"
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "led_transport.h"
+#include "soc/soc_caps.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Every LED bit is 3 SPI bits: 0 -> 100, 1 -> 110, 417ns each
+#define SPI_LED_CLOCK_HZ 2400000
+#define SPI_LED_BYTE_SIZE 3
+#define SPI_LED_RESET_BYTES 15 // 50us low
+#define SPI_LED_MAX_TRANSFER                                                   \
+  (LED_MAX_PIXELS * LED_MAX_BYTES_PER_PIXEL * SPI_LED_BYTE_SIZE +             \
+   SPI_LED_RESET_BYTES)
+// led_strip.c never has more than its two framebuffers in flight
+#define SPI_LED_QUEUE_DEPTH 2
+#define SPI_LED_MAX_CHANNELS (SOC_SPI_PERIPH_NUM - 1) // SPI1 is the flash
+static const char *TAG = "led_transport_spi";
+
+typedef struct spi_led_transport_t spi_led_transport_t;
+
+typedef struct {
+  spi_led_transport_t *transport;
+  int index;
+  spi_host_device_t host;
+  spi_device_handle_t device;
+  // Encoded frames, a buffer is reused once its transaction is collected
+  spi_transaction_t trans[SPI_LED_QUEUE_DEPTH];
+  uint8_t *buffers[SPI_LED_QUEUE_DEPTH];
+  size_t buffer_sizes[SPI_LED_QUEUE_DEPTH];
+  int next;
+  int pending; // queued and not collected
+} spi_led_channel_t;
+
+struct spi_led_transport_t {
+  led_transport_t base;
+  spi_led_channel_t channels[LED_MAX_CHANNELS];
+  int count;
+  led_transport_done_cb_t on_done;
+  void *user_ctx;
+  uint8_t bit_lut[256][SPI_LED_BYTE_SIZE];
+};
+
+static void IRAM_ATTR spi_led_post_cb(spi_transaction_t *trans) {
+  spi_led_channel_t *output = trans->user;
+  if (output->transport->on_done(output->index, output->transport->user_ctx))
+    portYIELD_FROM_ISR();
+}
+
+static void spi_led_init_lut(spi_led_transport_t *spi) {
+  for (int value = 0; value < 256; value++) {
+    uint32_t bits = 0;
+    for (int bit = 7; bit >= 0; bit--)
+      bits = (bits << 3) | ((value >> bit) & 1 ? 0x6 : 0x4);
+    spi->bit_lut[value][0] = bits >> 16;
+    spi->bit_lut[value][1] = bits >> 8;
+    spi->bit_lut[value][2] = bits;
+  }
+}
+
+static uint8_t *spi_led_encode(const spi_led_transport_t *spi, uint8_t *out,
+                               const uint8_t *bytes, size_t size,
+                               const uint8_t *levels) {
+  for (size_t i = 0; i < size; i++) {
+    const uint8_t *bits = spi->bit_lut[levels ? levels[bytes[i]] : bytes[i]];
+    *out++ = bits[0];
+    *out++ = bits[1];
+    *out++ = bits[2];
+  }
+  return out;
+}
+
+/*
+ * Repeats the first len bytes of out until size bytes are filled, copying
+ * everything filled so far each time: log2(size / len) memcpy calls
+ */
+static void spi_led_repeat(uint8_t *out, size_t len, size_t size) {
+  while (len < size) {
+    size_t copy = len < size - len ? len : size - len;
+    memcpy(out + len, out, copy);
+    len += copy;
+  }
+}
+
+/*
+ * Waits for the oldest queued transaction, its buffer can be reused then
+ */
+static esp_err_t spi_led_collect(spi_led_channel_t *output) {
+  spi_transaction_t *done;
+  ESP_RETURN_ON_ERROR(
+      spi_device_get_trans_result(output->device, &done, portMAX_DELAY), TAG,
+      "get transaction result failed");
+  output->pending--;
+  return ESP_OK;
+}
+
+static esp_err_t spi_led_deinit(led_transport_t *transport) {
+  spi_led_transport_t *spi =
+      __containerof(transport, spi_led_transport_t, base);
+  for (int i = 0; i < LED_MAX_CHANNELS; i++) {
+    spi_led_channel_t *output = &spi->channels[i];
+    while (output->device && output->pending)
+      spi_led_collect(output);
+    if (output->device) {
+      spi_bus_remove_device(output->device);
+      spi_bus_free(output->host);
+    }
+    for (int j = 0; j < SPI_LED_QUEUE_DEPTH; j++)
+      heap_caps_free(output->buffers[j]);
+  }
+  free(spi);
+  return ESP_OK;
+}
+
+static esp_err_t spi_led_init(led_transport_t *transport, const int *gpio_nums,
+                              int count, led_transport_done_cb_t on_done,
+                              void *user_ctx) {
+  spi_led_transport_t *spi =
+      __containerof(transport, spi_led_transport_t, base);
+  ESP_RETURN_ON_FALSE(count > 0 && count <= SPI_LED_MAX_CHANNELS &&
+                          count <= LED_MAX_CHANNELS && on_done,
+                      ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+  ESP_RETURN_ON_FALSE(!spi->count, ESP_ERR_INVALID_STATE, TAG,
+                      "channels are already initiated");
+  spi->on_done = on_done;
+  spi->user_ctx = user_ctx;
+
+  esp_err_t ret = ESP_OK;
+  int i;
+  for (i = 0; i < count; i++) {
+    spi_led_channel_t *output = &spi->channels[i];
+    output->transport = spi;
+    output->index = i;
+    output->host = SPI2_HOST + i;
+    spi_bus_config_t bus_config = {
+        .mosi_io_num = gpio_nums[i],
+        .miso_io_num = -1,
+        .sclk_io_num = -1,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = SPI_LED_MAX_TRANSFER,
+    };
+    ESP_GOTO_ON_ERROR(
+        spi_bus_initialize(output->host, &bus_config, SPI_DMA_CH_AUTO), err,
+        TAG, "initialize SPI bus failed");
+    spi_device_interface_config_t device_config = {
+        .clock_speed_hz = SPI_LED_CLOCK_HZ,
+        .mode = 0,
+        .spics_io_num = -1,
+        .queue_size = SPI_LED_QUEUE_DEPTH,
+        .post_cb = spi_led_post_cb,
+    };
+    ret = spi_bus_add_device(output->host, &device_config, &output->device);
+    if (ret != ESP_OK) {
+      spi_bus_free(output->host);
+      output->device = NULL;
+      ESP_LOGE(TAG, "add SPI device failed");
+      goto err;
+    }
+    ESP_LOGI(TAG, "LED output on GPIO %d", gpio_nums[i]);
+  }
+  spi->count = count;
+  // No hardware sync: channels are started back to back
+  return ESP_OK;
+
+err:
+  // The channels set up so far are released, so init can be retried
+  while (i-- > 0) {
+    spi_bus_remove_device(spi->channels[i].device);
+    spi_bus_free(spi->channels[i].host);
+    spi->channels[i].device = NULL;
+  }
+  return ret;
+}
+
+static esp_err_t spi_led_transmit(led_transport_t *transport, int channel,
+                                  const led_transport_frame_t *frame) {
+  spi_led_transport_t *spi =
+      __containerof(transport, spi_led_transport_t, base);
+  spi_led_channel_t *output = &spi->channels[channel];
+  size_t bytes = frame->is_solid
+                     ? frame->solid.count * frame->solid.bytes_per_pixel
+                     : frame->pixels.size;
+  size_t size = bytes * SPI_LED_BYTE_SIZE + SPI_LED_RESET_BYTES;
+  ESP_RETURN_ON_FALSE(size <= SPI_LED_MAX_TRANSFER, ESP_ERR_INVALID_SIZE, TAG,
+                      "frame is too long");
+
+  if (output->pending == SPI_LED_QUEUE_DEPTH)
+    ESP_RETURN_ON_ERROR(spi_led_collect(output), TAG, "collect failed");
+  int slot = output->next;
+  if (output->buffer_sizes[slot] < size) {
+    heap_caps_free(output->buffers[slot]);
+    output->buffers[slot] = heap_caps_malloc(size, MALLOC_CAP_DMA);
+    output->buffer_sizes[slot] = output->buffers[slot] ? size : 0;
+    ESP_RETURN_ON_FALSE(output->buffers[slot], ESP_ERR_NO_MEM, TAG,
+                        "no mem for spi frame");
+  }
+
+  // The frame is encoded now, its payload is not needed after this call
+  uint8_t *out = output->buffers[slot];
+  if (frame->is_solid) {
+    // One pixel is encoded, the rest of the frame is a copy of it
+    const led_solid_frame_t *solid = &frame->solid;
+    if (bytes) {
+      spi_led_encode(spi, out, solid->pixel, solid->bytes_per_pixel,
+                     solid->levels);
+      spi_led_repeat(out, solid->bytes_per_pixel * SPI_LED_BYTE_SIZE,
+                     bytes * SPI_LED_BYTE_SIZE);
+    }
+    out += bytes * SPI_LED_BYTE_SIZE;
+  } else {
+    out = spi_led_encode(spi, out, frame->pixels.pixels, frame->pixels.size,
+                         frame->pixels.levels);
+  }
+  memset(out, 0, SPI_LED_RESET_BYTES);
+
+  spi_transaction_t *trans = &output->trans[slot];
+  memset(trans, 0, sizeof(*trans));
+  trans->length = size * 8;
+  trans->tx_buffer = output->buffers[slot];
+  trans->user = output;
+  ESP_RETURN_ON_ERROR(
+      spi_device_queue_trans(output->device, trans, portMAX_DELAY), TAG,
+      "queue transaction failed");
+  output->pending++;
+  output->next = (slot + 1) % SPI_LED_QUEUE_DEPTH;
+  return ESP_OK;
+}
+
+static esp_err_t spi_led_wait(led_transport_t *transport, int channel) {
+  spi_led_transport_t *spi =
+      __containerof(transport, spi_led_transport_t, base);
+  spi_led_channel_t *output = &spi->channels[channel];
+  while (output->pending)
+    ESP_RETURN_ON_ERROR(spi_led_collect(output), TAG, "collect failed");
+  return ESP_OK;
+}
+
+esp_err_t led_new_spi_transport(led_transport_t **ret_transport) {
+  ESP_RETURN_ON_FALSE(ret_transport, ESP_ERR_INVALID_ARG, TAG,
+                      "invalid argument");
+  spi_led_transport_t *spi = calloc(1, sizeof(spi_led_transport_t));
+  ESP_RETURN_ON_FALSE(spi, ESP_ERR_NO_MEM, TAG, "no mem for spi transport");
+  spi->base.init = spi_led_init;
+  spi->base.transmit = spi_led_transmit;
+  spi->base.wait = spi_led_wait;
+  spi->base.deinit = spi_led_deinit;
+  spi_led_init_lut(spi);
+  *ret_transport = &spi->base;
+  return ESP_OK;
+}
@@ -0,0 +1,18 @@
+#include "esp_netif.h"
+#include <stdio.h>
+
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+esp_err_t esp_netif_init(void) { return ESP_OK; }
+
+esp_err_t esp_netif_set_hostname(esp_netif_t *esp_netif,
+                                 const char *hostname) {
+  return ESP_OK;
+}
+
+char *esp_ip4addr_ntoa(const esp_ip4_addr_t *addr, char *buf, int buflen) {
+  const uint8_t *bytes = (const uint8_t *)&addr->addr;
+  snprintf(buf, buflen, "%d.%d.%d.%d", bytes[0], bytes[1], bytes[2],
+           bytes[3]);
+  return buf;
+}
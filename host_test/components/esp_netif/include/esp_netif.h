@@ -0,0 +1,51 @@
+/*
+ * Host stub: the part of esp_netif used by the lamp, the host network stack
+ * is used directly
+ */
+#pragma once
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_IP4TOADDR(a, b, c, d)                                              \
+  (((uint32_t)(d) << 24) | ((uint32_t)(c) << 16) | ((uint32_t)(b) << 8) |     \
+   (uint32_t)(a))
+
+typedef struct esp_netif_obj esp_netif_t;
+
+typedef struct {
+  uint32_t addr; // network byte order
+} esp_ip4_addr_t;
+
+typedef struct {
+  esp_ip4_addr_t ip;
+  esp_ip4_addr_t netmask;
+  esp_ip4_addr_t gw;
+} esp_netif_ip_info_t;
+
+ESP_EVENT_DECLARE_BASE(IP_EVENT);
+
+typedef enum {
+  IP_EVENT_STA_GOT_IP,
+  IP_EVENT_STA_LOST_IP,
+} ip_event_t;
+
+typedef struct {
+  esp_netif_t *esp_netif;
+  esp_netif_ip_info_t ip_info;
+  bool ip_changed;
+} ip_event_got_ip_t;
+
+esp_err_t esp_netif_init(void);
+esp_err_t esp_netif_set_hostname(esp_netif_t *esp_netif, const char *hostname);
+char *esp_ip4addr_ntoa(const esp_ip4_addr_t *addr, char *buf, int buflen);
+
+#ifdef __cplusplus
+}
+#endif
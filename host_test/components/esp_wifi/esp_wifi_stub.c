@@ -0,0 +1,36 @@
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+
+struct esp_netif_obj {
+  int unused;
+};
+
+static esp_netif_t sta_netif;
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config) { return ESP_OK; }
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode) { return ESP_OK; }
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface,
+                              wifi_config_t *conf) {
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void) {
+  return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0,
+                        portMAX_DELAY);
+}
+
+esp_err_t esp_wifi_connect(void) {
+  ip_event_got_ip_t event = {
+      .esp_netif = &sta_netif,
+      .ip_info.ip.addr = ESP_IP4TOADDR(127, 0, 0, 1),
+      .ip_changed = true,
+  };
+  return esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof(event),
+                        portMAX_DELAY);
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void) { return &sta_netif; }
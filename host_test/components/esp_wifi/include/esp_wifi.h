@@ -0,0 +1,68 @@
+/*
+ * Host stub: the station "connects" at once and gets 127.0.0.1, the lamp is
+ * reached over loopback
+ */
+#pragma once
+
+#include "esp_bit_defs.h"
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ESP_EVENT_DECLARE_BASE(WIFI_EVENT);
+
+typedef enum {
+  WIFI_EVENT_STA_START = 2,
+  WIFI_EVENT_STA_STOP,
+  WIFI_EVENT_STA_CONNECTED,
+  WIFI_EVENT_STA_DISCONNECTED,
+} wifi_event_t;
+
+typedef enum {
+  WIFI_MODE_NULL = 0,
+  WIFI_MODE_STA,
+} wifi_mode_t;
+
+typedef enum {
+  WIFI_IF_STA = 0,
+} wifi_interface_t;
+
+typedef enum {
+  WIFI_AUTH_OPEN = 0,
+  WIFI_AUTH_WPA2_PSK = 3,
+} wifi_auth_mode_t;
+
+typedef struct {
+  int unused;
+} wifi_init_config_t;
+
+#define WIFI_INIT_CONFIG_DEFAULT()                                             \
+  { 0 }
+
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t password[64];
+  struct {
+    wifi_auth_mode_t authmode;
+  } threshold;
+} wifi_sta_config_t;
+
+typedef union {
+  wifi_sta_config_t sta;
+} wifi_config_t;
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config);
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode);
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_connect(void);
+esp_netif_t *esp_netif_create_default_wifi_sta(void);
+
+#ifdef __cplusplus
+}
+#endif
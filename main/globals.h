@@ -2,8 +2,16 @@
 #define __SMART_LAMP_GLOBALS_H__
 
 #include "led_strip.h"
+#include "sdkconfig.h"
 #include <stdint.h>
 
+#if CONFIG_IDF_TARGET_LINUX
+// Host build: web files are kept in ./spiffs of the working directory
+#define SPIFFS_BASE_PATH "spiffs"
+#else
+#define SPIFFS_BASE_PATH "/spiffs"
+#endif
+
 extern led_strip_state_t lamp_state;
 
 #endif
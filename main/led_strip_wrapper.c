@@ -1,73 +1,630 @@
-#include "driver/rmt_encoder.h"
-#include "driver/rmt_tx.h"
+#include "color_tables.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "globals.h"
+#include "led_compositor.h"
+#include "led_segment.h"
 #include "led_strip.h"
-#include "mdns.h"
+#include "led_strip_wrapper.h"
+#include "nvs.h"
+#include "render_task.h"
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
-#define RMT_LED_STRIP_RESOLUTION_HZ                                            \
-  10000000 // 10MHz resolution, 1 tick = 0.1us (led strip needs a high
-           // resolution)
-#define RMT_LED_STRIP_GPIO_NUM 19
+#define LED_STRIP_GPIO_NUM CONFIG_LED_CHANNEL_0_GPIO
 
+// Geometry used until another one is saved in NVS
 #define LED_COLS 1
 #define LED_ROWS 1
-#define EXAMPLE_CHASE_SPEED_MS 20
-#define BIT_PER_ONE_ADDRESS_LED 24
+#if CONFIG_LED_PIXEL_FORMAT_RGB
+#define LED_PIXEL_FORMAT LED_PIXEL_RGB
+#elif CONFIG_LED_PIXEL_FORMAT_GRBW
+#define LED_PIXEL_FORMAT LED_PIXEL_GRBW
+#elif CONFIG_LED_PIXEL_FORMAT_RGBW
+#define LED_PIXEL_FORMAT LED_PIXEL_RGBW
+#elif CONFIG_LED_PIXEL_FORMAT_GRB16
+#define LED_PIXEL_FORMAT LED_PIXEL_GRB16
+#elif CONFIG_LED_PIXEL_FORMAT_RGB16
+#define LED_PIXEL_FORMAT LED_PIXEL_RGB16
+#else
+#define LED_PIXEL_FORMAT LED_PIXEL_GRB
+#endif
+#define NVS_NAMESPACE "lamp"
+#define NOTIFICATION_PERIOD_MS 1000
+#define NOTIFICATION_MAX_OPACITY 192
+#define GEOMETRY_TIMEOUT_MS 2000 // the render task drains the queued frames
 
 const char *TAG = "led_strip_wrapper.c";
 
-typedef struct {
-  uint8_t r;
-  uint8_t g;
-  uint8_t b;
-} color_t;
+// Output brightness in 8.8 fixed point, lamp_state.brightness is its target
+static led_transition_t brightness_transition = {0};
+// Color temperature in kelvin, not in 8.8 fixed point
+static led_transition_t kelvin_transition = {0};
+static int frame_dirty = 0;
+// Given by the render task once a posted geometry was applied or refused
+static SemaphoreHandle_t geometry_done = NULL;
+static int geometry_applied = 0;
 
-color_t get_warm_light(uint8_t brightness) {
-  return (color_t){
-      .r = brightness, .g = (brightness * 60) / 102, .b = brightness / 3};
-}
+// Bottom to top, all of them are blended into one frame
+enum {
+  LAMP_LAYER_BASE = 0, // lamp light
+  LAMP_LAYER_SEGMENTS, // hidden while there are no segments
+  LAMP_LAYER_NOTIFICATION,
+  LAMP_LAYER_COUNT,
+};
+static led_compositor_t compositor = {.count = LAMP_LAYER_COUNT};
+static lamp_notification_t active_notification = LAMP_NOTIFICATION_NONE;
+static uint32_t notification_start_ms = 0;
+
+// Copy of lamp_state for the other tasks, updated by the setters
+static portMUX_TYPE settings_lock = portMUX_INITIALIZER_UNLOCKED;
+static lamp_settings_t settings;
+
+// Segments are edited by the HTTP task, the render task works on a copy
+static portMUX_TYPE segments_lock = portMUX_INITIALIZER_UNLOCKED;
+static led_segment_t segments[LED_MAX_SEGMENTS];
+static int segment_count = 0;
+static uint32_t segments_version = 0;
+static led_segment_t render_segments[LED_MAX_SEGMENTS];
+static int render_segment_count = 0;
+static uint32_t render_segments_version = 0;
+static led_effect_instance_t segment_effects[LED_MAX_SEGMENTS];
+static int segments_animated = 0;
+// Layer the segments are drawn into, one color and alpha per pixel
+static led_color_t *segment_colors = NULL;
+static uint8_t *segment_alpha = NULL;
+static size_t segment_pixels = 0;
 
-static void set_pixel_color(uint8_t *p_pixels, int offset, int r, int g,
-                            int b) {
-  int _offset = offset * 3; // Три пикселя в каждом светодиоде
-  // g, r, b - Реальная последовательность, а не rgb
-  p_pixels[_offset] = g;
-  p_pixels[_offset + 1] = r;
-  p_pixels[_offset + 2] = b;
+led_color_t get_warm_light(const led_pixel_ops_t *ops, uint8_t brightness) {
+  // Белый светодиод даёт больше света на миллиампер, чем смесь RGB
+  if (ops->has_white)
+    return (led_color_t){.w = brightness};
+  return (led_color_t){.r = warm_white_r[brightness],
+                       .g = warm_white_g[brightness],
+                       .b = warm_white_b[brightness]};
 }
 
-static uint8_t scale_0_100_to_0_255_fast(uint8_t value) {
+uint8_t scale_0_100_to_0_255_fast(uint8_t value) {
   if (value > 100)
     value = 100;
-  return (value * 255 + 50) / 100;
+  return percent_to_level[value];
 }
 
 uint8_t scale_0_255_to_0_100_fast(uint8_t value) {
-  if (value > 255)
-    value = 255;
-  return (value * 100 + 127) / 255;
+  return level_to_percent[value];
+}
+
+/*
+ * Lamp light at full scale, converted once per frame: a running color
+ * temperature fade costs one table lookup, not one per pixel
+ */
+static led_color_t lamp_color(uint32_t now_ms) {
+  led_color_t color;
+  switch (lamp_state.color_mode) {
+  case LED_COLOR_HSV:
+    color = led_hsv_to_rgb(lamp_state.color);
+    break;
+  case LED_COLOR_KELVIN:
+    color = led_kelvin_to_rgb(led_transition_step(&kelvin_transition, now_ms));
+    break;
+  default:
+    return get_warm_light(lamp_state.pixel_ops, 255);
+  }
+  return lamp_state.pixel_ops->has_white ? led_rgb_to_rgbw(color) : color;
+}
+
+/*
+ * Opacity of the notification layer: a triangle wave, so it pulses
+ */
+static uint8_t notification_opacity(uint32_t now_ms) {
+  if (active_notification == LAMP_NOTIFICATION_NONE)
+    return 0;
+  uint32_t period = NOTIFICATION_PERIOD_MS;
+  uint32_t phase = (now_ms - notification_start_ms) % period;
+  uint32_t half = period / 2;
+  uint32_t ramp = phase < half ? phase : period - phase;
+  return ramp * NOTIFICATION_MAX_OPACITY / half;
+}
+
+/*
+ * Takes the edited segments and redraws their layer if they or the strip size
+ * changed or an effect is running, all segments are drawn in the same frame
+ */
+static void update_segment_layer(size_t pixels, uint32_t now_ms) {
+  taskENTER_CRITICAL(&segments_lock);
+  int changed = render_segments_version != segments_version;
+  if (changed) {
+    memcpy(render_segments, segments, sizeof(segments));
+    render_segment_count = segment_count;
+    render_segments_version = segments_version;
+  }
+  taskEXIT_CRITICAL(&segments_lock);
+  if (changed) {
+    for (int i = render_segment_count; i < LED_MAX_SEGMENTS; i++)
+      led_effect_release(&segment_effects[i]);
+    segments_animated =
+        led_segments_animated(render_segments, render_segment_count);
+  }
+
+  led_layer_t *layer = &compositor.layers[LAMP_LAYER_SEGMENTS];
+  layer->opacity = 0;
+  if (!render_segment_count)
+    return;
+  if (pixels != segment_pixels) {
+    free(segment_colors);
+    free(segment_alpha);
+    segment_colors = malloc(pixels * sizeof(led_color_t));
+    segment_alpha = malloc(pixels);
+    if (!segment_colors || !segment_alpha) {
+      ESP_LOGE(TAG, "Not enough memory for the segments");
+      free(segment_colors);
+      free(segment_alpha);
+      segment_colors = NULL;
+      segment_alpha = NULL;
+      segment_pixels = 0;
+      return;
+    }
+    segment_pixels = pixels;
+    changed = 1;
+  }
+  if (changed || segments_animated)
+    led_segments_render(render_segments, segment_effects, render_segment_count,
+                        segment_colors, segment_alpha, pixels, now_ms);
+  layer->colors = segment_colors;
+  layer->alpha = segment_alpha;
+  layer->opacity = 255;
+}
+
+static void present_lamp_frame(uint8_t brightness, uint32_t now_ms) {
+  // Brightness is applied by the encoder, the color is kept at full scale
+  set_output_levels(brightness, gamma_cie1931);
+  const led_pixel_ops_t *ops = lamp_state.pixel_ops;
+  size_t count = lamp_state.cols * lamp_state.rows;
+  compositor.layers[LAMP_LAYER_BASE].color = lamp_color(now_ms);
+  update_segment_layer(count, now_ms);
+  compositor.layers[LAMP_LAYER_NOTIFICATION].opacity =
+      notification_opacity(now_ms);
+
+  // Uniform layers: one pixel is repeated by the encoder
+  led_color_t color;
+  if (led_compositor_solid(&compositor, &color)) {
+    uint8_t pixel[LED_MAX_BYTES_PER_PIXEL];
+    ops->set(pixel, 0, color);
+    present_solid_color(pixel, ops->bytes_per_pixel, count);
+    return;
+  }
+  lamp_state.p_pixels = acquire_back_buffer();
+  if (!lamp_state.p_pixels)
+    return;
+  led_compositor_render(&compositor, &lamp_state.layout, ops,
+                        lamp_state.p_pixels, count);
+  present_back_buffer();
+}
+
+static int is_valid_geometry(const led_layout_config_t *layout,
+                             led_pixel_format_t pixel_format) {
+  return layout->cols > 0 && layout->rows > 0 &&
+         (uint32_t)layout->cols * layout->rows <= LED_MAX_PIXELS &&
+         layout->wiring < LED_WIRING_MAX &&
+         layout->rotation < LED_ROTATION_MAX &&
+         pixel_format < LED_PIXEL_MAX;
+}
+
+static void load_geometry(led_layout_config_t *layout,
+                          led_pixel_format_t *pixel_format) {
+  *layout = (led_layout_config_t){.cols = LED_COLS, .rows = LED_ROWS};
+  *pixel_format = LED_PIXEL_FORMAT;
+
+  nvs_handle_t nvs;
+  if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+    return; // Ещё ничего не сохранено
+  led_layout_config_t saved = {0};
+  uint8_t format = 0, bpp = 0, wiring = 0, rotation = 0, mirror = 0;
+  if (nvs_get_u16(nvs, "cols", &saved.cols) == ESP_OK &&
+      nvs_get_u16(nvs, "rows", &saved.rows) == ESP_OK) {
+    // Прошлая прошивка сохраняла только число байт на пиксель
+    if (nvs_get_u8(nvs, "format", &format) != ESP_OK &&
+        nvs_get_u8(nvs, "bpp", &bpp) == ESP_OK)
+      format = bpp == 4 ? LED_PIXEL_GRBW : LED_PIXEL_GRB;
+    // Раскладка могла быть не сохранена прошлой прошивкой
+    nvs_get_u8(nvs, "wiring", &wiring);
+    nvs_get_u8(nvs, "rotation", &rotation);
+    nvs_get_u8(nvs, "mirror", &mirror);
+    saved.wiring = wiring;
+    saved.rotation = rotation;
+    saved.mirror_x = mirror & 1;
+    saved.mirror_y = (mirror >> 1) & 1;
+    if (is_valid_geometry(&saved, format)) {
+      *layout = saved;
+      *pixel_format = format;
+    }
+  }
+  nvs_close(nvs);
+}
+
+static void load_color() {
+  nvs_handle_t nvs;
+  if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+    return;
+  uint8_t mode = 0;
+  uint32_t hsv = 0;
+  uint16_t kelvin = 0;
+  // Ключи пишутся по отдельности, любого из них может не быть
+  if (nvs_get_u32(nvs, "color", &hsv) == ESP_OK)
+    lamp_state.color = (led_hsv_t){
+        .h = hsv >> 16, .s = hsv >> 8, .v = hsv};
+  if (nvs_get_u16(nvs, "kelvin", &kelvin) == ESP_OK &&
+      kelvin >= LED_KELVIN_MIN && kelvin <= LED_KELVIN_MAX)
+    lamp_state.kelvin = kelvin;
+  if (nvs_get_u8(nvs, "color_mode", &mode) == ESP_OK &&
+      mode <= LED_COLOR_KELVIN)
+    lamp_state.color_mode = mode;
+  nvs_close(nvs);
+}
+
+/*
+ * Called by the task which changes the color, the render task never waits
+ * for flash. Only the values given are written: color may be NULL and
+ * kelvin 0.
+ */
+static void save_color(led_color_mode_t mode, const led_hsv_t *color,
+                       uint16_t kelvin) {
+  nvs_handle_t nvs;
+  esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+  if (err == ESP_OK) {
+    err = nvs_set_u8(nvs, "color_mode", mode);
+    if (err == ESP_OK && color)
+      err = nvs_set_u32(nvs, "color",
+                        color->h << 16 | color->s << 8 | color->v);
+    if (err == ESP_OK && kelvin)
+      err = nvs_set_u16(nvs, "kelvin", kelvin);
+    if (err == ESP_OK)
+      err = nvs_commit(nvs);
+    nvs_close(nvs);
+  }
+  if (err != ESP_OK)
+    ESP_LOGE(TAG, "Failed to save color: %s", esp_err_to_name(err));
+}
+
+static void load_segments() {
+  nvs_handle_t nvs;
+  if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+    return;
+  led_segment_t saved[LED_MAX_SEGMENTS];
+  size_t size = sizeof(saved);
+  if (nvs_get_blob(nvs, "segments", saved, &size) == ESP_OK &&
+      size % sizeof(led_segment_t) == 0) {
+    // The geometry is not known yet, segments out of the strip are skipped
+    // when they are drawn
+    for (size_t i = 0; i < size / sizeof(led_segment_t); i++) {
+      if (led_segment_is_valid(&saved[i], LED_MAX_PIXELS))
+        segments[segment_count++] = saved[i];
+    }
+    segments_version++;
+  }
+  nvs_close(nvs);
+}
+
+static void save_segments() {
+  led_segment_t saved[LED_MAX_SEGMENTS];
+  int count = get_lamp_segments(saved);
+  nvs_handle_t nvs;
+  esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+  if (err == ESP_OK) {
+    err = nvs_set_blob(nvs, "segments", saved, count * sizeof(saved[0]));
+    if (err == ESP_OK)
+      err = nvs_commit(nvs);
+    nvs_close(nvs);
+  }
+  if (err != ESP_OK)
+    ESP_LOGE(TAG, "Failed to save segments: %s", esp_err_to_name(err));
+}
+
+/*
+ * Called by the task which changes the geometry, like save_color()
+ */
+static void save_geometry(const led_layout_config_t *layout,
+                          led_pixel_format_t pixel_format) {
+  nvs_handle_t nvs;
+  esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+  if (err == ESP_OK) {
+    err = nvs_set_u16(nvs, "cols", layout->cols);
+    if (err == ESP_OK)
+      err = nvs_set_u16(nvs, "rows", layout->rows);
+    if (err == ESP_OK)
+      err = nvs_set_u8(nvs, "format", pixel_format);
+    if (err == ESP_OK)
+      err = nvs_set_u8(nvs, "wiring", layout->wiring);
+    if (err == ESP_OK)
+      err = nvs_set_u8(nvs, "rotation", layout->rotation);
+    if (err == ESP_OK)
+      err = nvs_set_u8(nvs, "mirror",
+                       layout->mirror_x | (layout->mirror_y << 1));
+    if (err == ESP_OK)
+      err = nvs_commit(nvs);
+    nvs_close(nvs);
+  }
+  if (err != ESP_OK)
+    ESP_LOGE(TAG, "Failed to save geometry (%s)", esp_err_to_name(err));
 }
 
-static void set_brightness_cb(uint8_t *p_pixels, int index) {
-  color_t color = get_warm_light(lamp_state.brightness);
-  set_pixel_color(lamp_state.p_pixels, index, color.r, color.g, color.b);
+/*
+ * Derived fields of lamp_state.layout_config and pixel_format
+ */
+static void update_geometry_state() {
+  lamp_state.pixel_ops = led_pixel_ops(lamp_state.pixel_format);
+  lamp_state.bytes_per_pixel = lamp_state.pixel_ops->bytes_per_pixel;
+  lamp_state.cols = lamp_state.layout_config.cols;
+  lamp_state.rows = lamp_state.layout_config.rows;
+  lamp_state.pixels_size =
+      lamp_state.cols * lamp_state.rows * lamp_state.bytes_per_pixel;
 }
 
-static void update_led_strip_brightness() {
-  traverse_matrix(lamp_state.p_pixels, set_brightness_cb,
-                  EXAMPLE_CHASE_SPEED_MS, lamp_state.cols, lamp_state.rows);
-  transmit_pixels_data(lamp_state.p_pixels, lamp_state.pixels_size);
+/*
+ * Rendering is paused while the task is here, so the buffers can be swapped.
+ * Returns 0 if there is not enough memory, the old geometry stays then.
+ */
+static int apply_geometry(const led_layout_config_t *layout,
+                          led_pixel_format_t pixel_format) {
+  const led_layout_config_t *current = &lamp_state.layout_config;
+  if (!memcmp(layout, current, sizeof(*layout)) &&
+      pixel_format == lamp_state.pixel_format)
+    return 1;
+  const led_pixel_ops_t *ops = led_pixel_ops(pixel_format);
+  uint8_t bytes_per_pixel = ops->bytes_per_pixel;
+  size_t pixels = layout->cols * layout->rows;
+  size_t size = pixels * bytes_per_pixel;
+  // Segments of the channels are split at pixel boundaries
+  if ((size != lamp_state.pixels_size ||
+       bytes_per_pixel != lamp_state.bytes_per_pixel) &&
+      !resize_framebuffer(pixels, bytes_per_pixel)) {
+    ESP_LOGE(TAG, "Not enough memory for %dx%d LEDs", layout->cols,
+             layout->rows);
+    return 0;
+  }
+  lamp_state.pixels_size = size;
+  lamp_state.p_pixels = acquire_back_buffer();
+  lamp_state.bytes_per_pixel = bytes_per_pixel;
+  lamp_state.pixel_format = pixel_format;
+  lamp_state.pixel_ops = ops;
+  if (!led_layout_init(&lamp_state.layout, layout)) {
+    // Размер уже применён, старая таблица для него не подходит
+    ESP_LOGE(TAG, "Not enough memory for the layout table");
+    led_layout_free(&lamp_state.layout);
+  }
+  lamp_state.layout_config = *layout;
+  lamp_state.cols = layout->cols;
+  lamp_state.rows = layout->rows;
+  ESP_LOGI(TAG, "Geometry: %dx%d, %s pixels", layout->cols, layout->rows,
+           ops->name);
+  return 1;
+}
+
+/*
+ * Called from the render task only, it owns lamp_state.p_pixels
+ */
+void render_lamp_command(const lamp_command_t *cmd, uint32_t now_ms) {
+  if (cmd->fields & LAMP_CMD_GEOMETRY) {
+    geometry_applied = apply_geometry(&cmd->layout, cmd->pixel_format);
+    xSemaphoreGive(geometry_done);
+    frame_dirty = 1;
+  }
+  // Пропуск если не изменилось
+  if ((cmd->fields & LAMP_CMD_BRIGHTNESS) &&
+      brightness_transition.to != cmd->brightness << 8) {
+    lamp_state.brightness = cmd->brightness;
+    led_transition_start(&brightness_transition, cmd->brightness << 8,
+                         cmd->transition_ms, cmd->easing, now_ms);
+    frame_dirty = 1;
+  }
+  if ((cmd->fields & LAMP_CMD_NOTIFICATION) &&
+      cmd->notification != active_notification) {
+    active_notification = cmd->notification;
+    notification_start_ms = now_ms;
+    frame_dirty = 1;
+  }
+  if (cmd->fields & LAMP_CMD_SEGMENTS)
+    frame_dirty = 1;
+  if ((cmd->fields & LAMP_CMD_HSV) &&
+      memcmp(&cmd->color, &lamp_state.color, sizeof(cmd->color))) {
+    lamp_state.color = cmd->color;
+    frame_dirty = 1;
+  }
+  if ((cmd->fields & LAMP_CMD_KELVIN) && cmd->kelvin != lamp_state.kelvin) {
+    // Плавно только между температурами, из другого режима сразу
+    if (lamp_state.color_mode == LED_COLOR_KELVIN)
+      led_transition_start(&kelvin_transition, cmd->kelvin,
+                           cmd->color_transition_ms, LED_EASING_IN_OUT,
+                           now_ms);
+    else
+      led_transition_set(&kelvin_transition, cmd->kelvin);
+    lamp_state.kelvin = cmd->kelvin;
+    frame_dirty = 1;
+  }
+  if ((cmd->fields & LAMP_CMD_COLOR_MODE) &&
+      cmd->color_mode != lamp_state.color_mode) {
+    if (cmd->color_mode == LED_COLOR_KELVIN)
+      led_transition_set(&kelvin_transition, lamp_state.kelvin);
+    lamp_state.color_mode = cmd->color_mode;
+    frame_dirty = 1;
+  }
+}
+
+/*
+ * Renders one frame if anything changed, returns 1 while a transition, an
+ * effect or a notification is running and more frames are needed
+ */
+int render_lamp_frame(uint32_t now_ms) {
+  if (!lamp_state.p_pixels)
+    return 0;
+  int animating = led_transition_active(&brightness_transition) ||
+                  led_transition_active(&kelvin_transition) ||
+                  active_notification != LAMP_NOTIFICATION_NONE ||
+                  segments_animated;
+  if (!frame_dirty && !animating)
+    return 0;
+  // One interpolation per frame, whatever the strip length is
+  uint16_t brightness = led_transition_step(&brightness_transition, now_ms);
+  present_lamp_frame(brightness >> 8, now_ms);
+  frame_dirty = 0;
+  return led_transition_active(&brightness_transition) ||
+         led_transition_active(&kelvin_transition) ||
+         active_notification != LAMP_NOTIFICATION_NONE || segments_animated;
+}
+
+/*
+ * Safe to call from any task: the value is handed over to the render task
+ */
+void set_brightness_transition(uint8_t percent_value, uint32_t duration_ms,
+                               led_easing_t easing) {
+  lamp_command_t cmd = {
+      .fields = LAMP_CMD_BRIGHTNESS,
+      .brightness = scale_0_100_to_0_255_fast(percent_value),
+      .transition_ms = duration_ms,
+      .easing = easing,
+  };
+  taskENTER_CRITICAL(&settings_lock);
+  settings.brightness = cmd.brightness;
+  taskEXIT_CRITICAL(&settings_lock);
+  post_lamp_command(&cmd);
 }
 
 void set_brightness_value(uint8_t percent_value) {
-  uint8_t result_value = scale_0_100_to_0_255_fast(percent_value);
-  if (result_value == lamp_state.brightness)
-    return; // Пропуск если не изменилось
-  lamp_state.brightness = result_value;
-  update_led_strip_brightness();
+  set_brightness_transition(percent_value, DEFAULT_TRANSITION_MS,
+                            LED_EASING_IN_OUT);
+}
+
+void set_lamp_notification(lamp_notification_t notification) {
+  lamp_command_t cmd = {
+      .fields = LAMP_CMD_NOTIFICATION,
+      .notification = notification,
+  };
+  post_lamp_command(&cmd);
+}
+
+void set_lamp_color(led_color_mode_t mode, const led_hsv_t *color) {
+  // The values which are not sent stay as the render task has them
+  lamp_command_t cmd = {
+      .fields = LAMP_CMD_COLOR_MODE,
+      .color_mode = mode,
+  };
+  if (color) {
+    cmd.fields |= LAMP_CMD_HSV;
+    cmd.color = *color;
+  }
+  taskENTER_CRITICAL(&settings_lock);
+  settings.color_mode = mode;
+  if (color)
+    settings.color = *color;
+  taskEXIT_CRITICAL(&settings_lock);
+  post_lamp_command(&cmd);
+  save_color(mode, color, 0);
+}
+
+void set_lamp_kelvin(uint16_t kelvin, uint32_t duration_ms) {
+  if (kelvin < LED_KELVIN_MIN)
+    kelvin = LED_KELVIN_MIN;
+  if (kelvin > LED_KELVIN_MAX)
+    kelvin = LED_KELVIN_MAX;
+  lamp_command_t cmd = {
+      .fields = LAMP_CMD_COLOR_MODE | LAMP_CMD_KELVIN,
+      .color_mode = LED_COLOR_KELVIN,
+      .kelvin = kelvin,
+      .color_transition_ms = duration_ms,
+  };
+  taskENTER_CRITICAL(&settings_lock);
+  settings.color_mode = LED_COLOR_KELVIN;
+  settings.kelvin = kelvin;
+  taskEXIT_CRITICAL(&settings_lock);
+  post_lamp_command(&cmd);
+  save_color(LED_COLOR_KELVIN, NULL, kelvin);
+}
+
+static void post_segments_changed() {
+  lamp_command_t cmd = {.fields = LAMP_CMD_SEGMENTS};
+  post_lamp_command(&cmd);
+}
+
+int set_lamp_segment(const led_segment_t *segment) {
+  lamp_settings_t current;
+  get_lamp_settings(&current);
+  if (!led_segment_is_valid(segment,
+                            current.layout.cols * current.layout.rows))
+    return 0;
+  taskENTER_CRITICAL(&segments_lock);
+  int index = led_segment_find(segments, segment_count, segment->name);
+  if (index < 0 && segment_count < LED_MAX_SEGMENTS)
+    index = segment_count++;
+  if (index >= 0) {
+    segments[index] = *segment;
+    segments_version++;
+  }
+  taskEXIT_CRITICAL(&segments_lock);
+  if (index < 0)
+    return 0;
+  save_segments();
+  post_segments_changed();
+  return 1;
+}
+
+int delete_lamp_segment(const char *name) {
+  taskENTER_CRITICAL(&segments_lock);
+  int index = led_segment_find(segments, segment_count, name);
+  if (index >= 0) {
+    // Order is kept, it decides which of overlapping segments is on top
+    memmove(&segments[index], &segments[index + 1],
+            (segment_count - index - 1) * sizeof(segments[0]));
+    segment_count--;
+    segments_version++;
+  }
+  taskEXIT_CRITICAL(&segments_lock);
+  if (index < 0)
+    return 0;
+  save_segments();
+  post_segments_changed();
+  return 1;
+}
+
+int get_lamp_segments(led_segment_t *out) {
+  taskENTER_CRITICAL(&segments_lock);
+  int count = segment_count;
+  memcpy(out, segments, count * sizeof(segments[0]));
+  taskEXIT_CRITICAL(&segments_lock);
+  return count;
+}
+
+int set_led_geometry(const led_layout_config_t *layout,
+                     led_pixel_format_t pixel_format) {
+  if (!geometry_done || !is_valid_geometry(layout, pixel_format))
+    return 0;
+  lamp_command_t cmd = {
+      .fields = LAMP_CMD_GEOMETRY,
+      .layout = *layout,
+      .pixel_format = pixel_format,
+  };
+  // The result of a request which timed out is dropped
+  xSemaphoreTake(geometry_done, 0);
+  post_lamp_command(&cmd);
+  // Только применённая геометрия сохраняется: иначе после перезагрузки
+  // лампа не выделит под неё буферы и не загорится
+  if (xSemaphoreTake(geometry_done, pdMS_TO_TICKS(GEOMETRY_TIMEOUT_MS)) !=
+          pdTRUE ||
+      !geometry_applied)
+    return 0;
+  taskENTER_CRITICAL(&settings_lock);
+  settings.layout = *layout;
+  settings.pixel_format = pixel_format;
+  taskEXIT_CRITICAL(&settings_lock);
+  save_geometry(layout, pixel_format);
+  return 1;
+}
+
+void get_lamp_settings(lamp_settings_t *out) {
+  taskENTER_CRITICAL(&settings_lock);
+  *out = settings;
+  taskEXIT_CRITICAL(&settings_lock);
 }
 
 void init_led() {
@@ -77,18 +634,69 @@ void init_led() {
   }
 
   lamp_state.is_initiated = 1;
-  lamp_state.cols = LED_COLS;
-  lamp_state.rows = LED_ROWS;
-  lamp_state.gpio_num = RMT_LED_STRIP_GPIO_NUM;
-  lamp_state.pixels_size = LED_ROWS * LED_ROWS * BIT_PER_ONE_ADDRESS_LED;
-  lamp_state.p_pixels = malloc(lamp_state.pixels_size);
+  compositor.layers[LAMP_LAYER_BASE] = (led_layer_t){.opacity = 255};
+  compositor.layers[LAMP_LAYER_SEGMENTS] = (led_layer_t){.opacity = 0};
+  compositor.layers[LAMP_LAYER_NOTIFICATION] = (led_layer_t){
+      .color = {.b = 255}, // cold blue, stands out from the warm light
+      .mode = LED_BLEND_NORMAL,
+  };
+  geometry_done = xSemaphoreCreateBinary();
+  load_geometry(&lamp_state.layout_config, &lamp_state.pixel_format);
+  update_geometry_state();
+  load_segments();
+  lamp_state.kelvin = CONFIG_LAMP_WARM_WHITE_KELVIN;
+  load_color();
+  led_transition_set(&kelvin_transition, lamp_state.kelvin);
+  lamp_state.gpio_num = LED_STRIP_GPIO_NUM;
+
+  ESP_LOGI(TAG, "init_led with brightness: %d", lamp_state.brightness);
+  const int gpio_nums[] = {
+      CONFIG_LED_CHANNEL_0_GPIO,
+#if CONFIG_LED_CHANNEL_COUNT >= 2
+      CONFIG_LED_CHANNEL_1_GPIO,
+#endif
+#if CONFIG_LED_CHANNEL_COUNT >= 3
+      CONFIG_LED_CHANNEL_2_GPIO,
+#endif
+#if CONFIG_LED_CHANNEL_COUNT >= 4
+      CONFIG_LED_CHANNEL_3_GPIO,
+#endif
+  };
+  init_led_channels(gpio_nums, CONFIG_LED_CHANNEL_COUNT);
+  init_framebuffer(lamp_state.cols * lamp_state.rows,
+                   lamp_state.bytes_per_pixel);
+  lamp_state.p_pixels = acquire_back_buffer();
+  if (!lamp_state.p_pixels &&
+      (lamp_state.cols != LED_COLS || lamp_state.rows != LED_ROWS)) {
+    // Сохранённая геометрия не помещается в память, без этого лампа
+    // не загорится, пока NVS не очистят
+    ESP_LOGE(TAG, "No memory for %dx%d LEDs, falling back to %dx%d",
+             lamp_state.cols, lamp_state.rows, LED_COLS, LED_ROWS);
+    lamp_state.layout_config =
+        (led_layout_config_t){.cols = LED_COLS, .rows = LED_ROWS};
+    lamp_state.pixel_format = LED_PIXEL_FORMAT;
+    update_geometry_state();
+    init_framebuffer(lamp_state.cols * lamp_state.rows,
+                     lamp_state.bytes_per_pixel);
+    lamp_state.p_pixels = acquire_back_buffer();
+  }
+  if (!led_layout_init(&lamp_state.layout, &lamp_state.layout_config))
+    ESP_LOGE(TAG, "Layout memory allocation error");
+  // The render task is not running yet
+  settings = (lamp_settings_t){
+      .brightness = lamp_state.brightness,
+      .color_mode = lamp_state.color_mode,
+      .color = lamp_state.color,
+      .kelvin = lamp_state.kelvin,
+      .layout = lamp_state.layout_config,
+      .pixel_format = lamp_state.pixel_format,
+  };
 
   if (!lamp_state.p_pixels) {
     ESP_LOGE(TAG, "Pixels memory allocation error");
     return;
   }
 
-  ESP_LOGI(TAG, "init_led with brightness: %d", lamp_state.brightness);
-  init_rmt_encoder(RMT_LED_STRIP_GPIO_NUM);
   reset_pixels_array(lamp_state.p_pixels, lamp_state.pixels_size);
+  start_render_task();
 }
@@ -1,7 +1,69 @@
 #ifndef __SMART_LAMP_LED_STRIP_WRAPPER_H__
 #define __SMART_LAMP_LED_STRIP_WRAPPER_H__
+#include "led_layout.h"
+#include "led_segment.h"
+#include "render_task.h"
 #include <stdint.h>
+
+#define DEFAULT_TRANSITION_MS 300
+
+/*
+ * Lamp settings as they were last set, for the HTTP task: lamp_state belongs
+ * to the render task and is never read by other tasks
+ */
+typedef struct {
+  uint8_t brightness; // 0-255, target of a running transition
+  led_color_mode_t color_mode;
+  led_hsv_t color;
+  uint16_t kelvin;
+  led_layout_config_t layout;
+  led_pixel_format_t pixel_format;
+} lamp_settings_t;
+
 uint8_t scale_0_255_to_0_100_fast(uint8_t value);
+uint8_t scale_0_100_to_0_255_fast(uint8_t value);
+/*
+ * Lamp light color at full scale of the pixel format
+ */
+led_color_t get_warm_light(const led_pixel_ops_t *ops, uint8_t brightness);
 void set_brightness_value(uint8_t percent_value);
+void set_brightness_transition(uint8_t percent_value, uint32_t duration_ms,
+                               led_easing_t easing);
+void get_lamp_settings(lamp_settings_t *out);
+/*
+ * Waits until the render task applied the geometry and saves it in NVS then.
+ * Returns 0 if it is out of range or doesn't fit into memory.
+ */
+int set_led_geometry(const led_layout_config_t *layout,
+                     led_pixel_format_t pixel_format);
+/*
+ * Safe to call from any task, LAMP_NOTIFICATION_NONE clears it
+ */
+void set_lamp_notification(lamp_notification_t notification);
+/*
+ * Color mode of the whole lamp, color is used by LED_COLOR_HSV. Without a
+ * color (NULL) the lamp keeps its last one. Saved in NVS.
+ */
+void set_lamp_color(led_color_mode_t mode, const led_hsv_t *color);
+/*
+ * Switches to color temperature light, fading from the current temperature
+ * if the lamp already was in that mode. Saved in NVS.
+ */
+void set_lamp_kelvin(uint16_t kelvin, uint32_t duration_ms);
+/*
+ * Adds the segment or replaces the one with the same name, it is saved in NVS.
+ * Returns 0 if it doesn't fit the strip or there are too many segments.
+ */
+int set_lamp_segment(const led_segment_t *segment);
+/*
+ * Returns 0 if there is no segment with the name
+ */
+int delete_lamp_segment(const char *name);
+/*
+ * Copies up to LED_MAX_SEGMENTS segments into out, returns their number
+ */
+int get_lamp_segments(led_segment_t *out);
+void render_lamp_command(const lamp_command_t *cmd, uint32_t now_ms);
+int render_lamp_frame(uint32_t now_ms);
 void init_led();
 #endif
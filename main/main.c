@@ -18,11 +18,10 @@
 #include "globals.h"
 #include "led_strip.h"
 #include "led_strip_wrapper.h"
-#include "lwip/err.h"
-#include "lwip/inet.h"
-#include "lwip/sys.h"
 #include "nvs.h"
 #include "nvs_flash.h"
+#include "web_assets.h"
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -36,7 +35,6 @@
 #define EXAMPLE_ESP_WIFI_PASS CONFIG_ESP_WIFI_PASSWORD
 #define EXAMPLE_ESP_MAXIMUM_RETRY CONFIG_ESP_MAXIMUM_RETRY
 
-#define RMT_LED_STRIP_GPIO_NUM 19
 /* server functions defined here >>  */
 void start_server();
 /* led strip wrapper functions defined here >>  */
@@ -57,7 +55,7 @@ static const char *TAG = "wifi station";
 static void init_spiffs(void) {
   ESP_LOGI(TAG, "Initializing SPIFFS");
 
-  esp_vfs_spiffs_conf_t conf = {.base_path = "/spiffs",
+  esp_vfs_spiffs_conf_t conf = {.base_path = SPIFFS_BASE_PATH,
                                 .partition_label = NULL,
                                 .max_files = 5,
                                 .format_if_mount_failed = true};
@@ -172,6 +170,7 @@ void wifi_init_sta(void) {
   if (bits & WIFI_CONNECTED_BIT) {
     ESP_LOGI(TAG, "connected to ap SSID:%s", EXAMPLE_ESP_WIFI_SSID);
     init_spiffs();
+    init_web_assets();
     start_server();
   } else if (bits & WIFI_FAIL_BIT) {
     ESP_LOGI(TAG, "Failed to connect to SSID:%s", EXAMPLE_ESP_WIFI_SSID);
@@ -183,7 +182,8 @@ void wifi_init_sta(void) {
 void app_main() {
   ESP_ERROR_CHECK(nvs_flash_init());
 
+  // До сервера: обработчики читают настройки, которые заполняет init_led
+  init_led();
   ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
   wifi_init_sta();
-  init_led();
 }
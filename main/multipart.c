@@ -0,0 +1,189 @@
+#include "multipart.h"
+#include <string.h>
+#include <strings.h>
+
+/*
+ * Copies parameter key of a header line ("...; key=value" or key="value")
+ * into out, "" if it is missing
+ */
+static void header_param(const char *header, const char *key, char *out,
+                         size_t size) {
+  size_t key_len = strlen(key);
+  out[0] = '\0';
+  for (const char *param = strchr(header, ';'); param;
+       param = strchr(param, ';')) {
+    param++;
+    param += strspn(param, " \t");
+    if (strncasecmp(param, key, key_len) || param[key_len] != '=')
+      continue;
+    const char *value = param + key_len + 1;
+    size_t len;
+    if (*value == '"') {
+      value++;
+      len = strcspn(value, "\"");
+    } else {
+      len = strcspn(value, "; \t");
+    }
+    if (len >= size)
+      len = size - 1;
+    memcpy(out, value, len);
+    out[len] = '\0';
+    return;
+  }
+}
+
+int multipart_boundary(const char *content_type, char *out, size_t size) {
+  const char *value = strstr(content_type, "boundary=");
+  if (!value)
+    return 0;
+  value += strlen("boundary=");
+  size_t len;
+  if (*value == '"') {
+    value++;
+    len = strcspn(value, "\"");
+  } else {
+    len = strcspn(value, "; \t");
+  }
+  if (!len || len > MULTIPART_BOUNDARY_MAX || len >= size)
+    return 0;
+  memcpy(out, value, len);
+  out[len] = '\0';
+  return 1;
+}
+
+int multipart_parser_init(multipart_parser_t *parser, const char *boundary,
+                          const multipart_callbacks_t *callbacks, void *ctx) {
+  size_t len = strlen(boundary);
+  if (!len || len > MULTIPART_BOUNDARY_MAX)
+    return 0;
+  *parser = (multipart_parser_t){.callbacks = callbacks, .ctx = ctx};
+  memcpy(parser->delimiter, "\r\n--", 4);
+  memcpy(parser->delimiter + 4, boundary, len);
+  parser->delimiter_len = 4 + len;
+  // The first delimiter may open the body without a line end before it
+  parser->match = 2;
+  return 1;
+}
+
+static int emit_data(multipart_parser_t *parser, const void *data,
+                     size_t len) {
+  if (parser->state != MULTIPART_DATA || !len)
+    return 1;
+  return parser->callbacks->on_part_data(parser->ctx, data, len) == 0;
+}
+
+static int end_header_line(multipart_parser_t *parser) {
+  parser->header[parser->header_len] = '\0';
+  if (!parser->header_len) {
+    // Empty line: the headers are over, the contents follow
+    parser->state = MULTIPART_DATA;
+    parser->match = 0;
+    return parser->callbacks->on_part_begin(parser->ctx, parser->name,
+                                            parser->filename) == 0;
+  }
+  if (!strncasecmp(parser->header, "Content-Disposition:",
+                   strlen("Content-Disposition:"))) {
+    header_param(parser->header, "name", parser->name, sizeof(parser->name));
+    header_param(parser->header, "filename", parser->filename,
+                 sizeof(parser->filename));
+  }
+  parser->header_len = 0;
+  parser->state = MULTIPART_HEADER;
+  return 1;
+}
+
+/*
+ * Preamble and part contents: everything up to the next delimiter. Runs
+ * without a '\r' are passed on at once. The delimiter has '\r' only at its
+ * start (a boundary can't contain one), so on a mismatch the bytes matched
+ * so far are plain data and matching restarts at the current byte.
+ */
+static size_t feed_until_delimiter(multipart_parser_t *parser,
+                                   const uint8_t *data, size_t len) {
+  size_t i = 0;
+  while (i < len) {
+    if (!parser->match) {
+      const uint8_t *cr = memchr(data + i, '\r', len - i);
+      size_t run = cr ? (size_t)(cr - (data + i)) : len - i;
+      if (!emit_data(parser, data + i, run))
+        return 0;
+      i += run;
+      if (i == len)
+        break;
+    }
+    if (data[i] == (uint8_t)parser->delimiter[parser->match]) {
+      i++;
+      if (++parser->match == parser->delimiter_len) {
+        parser->match = 0;
+        if (parser->state == MULTIPART_DATA &&
+            parser->callbacks->on_part_end(parser->ctx))
+          return 0;
+        parser->state = MULTIPART_BOUNDARY_END;
+        return i;
+      }
+    } else {
+      if (!emit_data(parser, parser->delimiter, parser->match))
+        return 0;
+      parser->match = 0;
+    }
+  }
+  return i;
+}
+
+int multipart_parser_feed(multipart_parser_t *parser, const uint8_t *data,
+                          size_t len) {
+  size_t i = 0;
+  while (i < len) {
+    uint8_t c = data[i];
+    switch (parser->state) {
+    case MULTIPART_PREAMBLE:
+    case MULTIPART_DATA: {
+      size_t used = feed_until_delimiter(parser, data + i, len - i);
+      if (!used) {
+        parser->state = MULTIPART_ERROR;
+        return 0;
+      }
+      i += used;
+      continue;
+    }
+    case MULTIPART_BOUNDARY_END:
+      if (c == '-')
+        parser->state = MULTIPART_BOUNDARY_HYPHEN;
+      else if (c == '\r')
+        parser->state = MULTIPART_BOUNDARY_LF;
+      else if (c != ' ' && c != '\t') // transport padding
+        parser->state = MULTIPART_ERROR;
+      break;
+    case MULTIPART_BOUNDARY_HYPHEN:
+      parser->state = c == '-' ? MULTIPART_DONE : MULTIPART_ERROR;
+      break;
+    case MULTIPART_BOUNDARY_LF:
+      if (c == '\n') {
+        parser->state = MULTIPART_HEADER;
+        parser->header_len = 0;
+        parser->name[0] = parser->filename[0] = '\0';
+      } else {
+        parser->state = MULTIPART_ERROR;
+      }
+      break;
+    case MULTIPART_HEADER:
+      if (c == '\r')
+        parser->state = MULTIPART_HEADER_LF;
+      else if (parser->header_len < sizeof(parser->header) - 1)
+        parser->header[parser->header_len++] = c;
+      else
+        parser->state = MULTIPART_ERROR; // the line is too long
+      break;
+    case MULTIPART_HEADER_LF:
+      if (c != '\n' || !end_header_line(parser))
+        parser->state = MULTIPART_ERROR;
+      break;
+    case MULTIPART_DONE:
+      return 1; // epilogue
+    case MULTIPART_ERROR:
+      return 0;
+    }
+    i++;
+  }
+  return parser->state != MULTIPART_ERROR;
+}
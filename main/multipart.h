@@ -0,0 +1,72 @@
+#ifndef __SMART_LAMP_MULTIPART_H__
+#define __SMART_LAMP_MULTIPART_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MULTIPART_BOUNDARY_MAX 70 // RFC 2046
+#define MULTIPART_HEADER_MAX 256  // one header line of a part
+#define MULTIPART_NAME_SIZE 64
+
+/*
+ * Called by the parser, a non zero return stops it with an error
+ */
+typedef struct {
+  // Headers of a part are parsed, filename is "" for plain form fields
+  int (*on_part_begin)(void *ctx, const char *name, const char *filename);
+  int (*on_part_data)(void *ctx, const uint8_t *data, size_t len);
+  int (*on_part_end)(void *ctx);
+} multipart_callbacks_t;
+
+typedef enum {
+  MULTIPART_PREAMBLE = 0,
+  MULTIPART_BOUNDARY_END, // after a delimiter: "--" or line end follows
+  MULTIPART_BOUNDARY_HYPHEN,
+  MULTIPART_BOUNDARY_LF,
+  MULTIPART_HEADER,
+  MULTIPART_HEADER_LF,
+  MULTIPART_DATA,
+  MULTIPART_DONE, // the closing delimiter was seen, the rest is ignored
+  MULTIPART_ERROR,
+} multipart_state_t;
+
+/*
+ * Incremental multipart/form-data parser: the body can be fed in chunks of
+ * any size, a delimiter split between two chunks is still found. Nothing is
+ * allocated, data is passed through to on_part_data.
+ */
+typedef struct {
+  const multipart_callbacks_t *callbacks;
+  void *ctx;
+  multipart_state_t state;
+  char delimiter[4 + MULTIPART_BOUNDARY_MAX]; // "\r\n--" boundary
+  size_t delimiter_len;
+  size_t match; // delimiter bytes matched so far
+  char header[MULTIPART_HEADER_MAX];
+  size_t header_len;
+  char name[MULTIPART_NAME_SIZE];
+  char filename[MULTIPART_NAME_SIZE];
+} multipart_parser_t;
+
+/*
+ * Copies the boundary parameter of a Content-Type header value into out,
+ * returns 0 if there is none or it doesn't fit
+ */
+int multipart_boundary(const char *content_type, char *out, size_t size);
+/*
+ * Returns 0 if the boundary is empty or too long
+ */
+int multipart_parser_init(multipart_parser_t *parser, const char *boundary,
+                          const multipart_callbacks_t *callbacks, void *ctx);
+/*
+ * Parses the next chunk of the body, returns 0 once the body is malformed or
+ * a callback failed
+ */
+int multipart_parser_feed(multipart_parser_t *parser, const uint8_t *data,
+                          size_t len);
+
+static inline int multipart_parser_done(const multipart_parser_t *parser) {
+  return parser->state == MULTIPART_DONE;
+}
+
+#endif
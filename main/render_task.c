@@ -0,0 +1,102 @@
+#include "render_task.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "led_strip_wrapper.h"
+#include <string.h>
+
+#define RENDER_TASK_STACK_SIZE 4096
+#define RENDER_TASK_PRIORITY 5
+// The last core, so the render loop does not compete with Wi-Fi and httpd
+#define RENDER_TASK_CORE (portNUM_PROCESSORS - 1)
+#define RENDER_FRAME_PERIOD_MS (1000 / CONFIG_LED_FRAME_RATE)
+
+static const char *TAG = "render_task";
+
+static TaskHandle_t s_render_task = NULL;
+// Mailbox: pending command, merged under the spinlock
+static portMUX_TYPE s_mailbox_lock = portMUX_INITIALIZER_UNLOCKED;
+static lamp_command_t s_pending = {0};
+
+void post_lamp_command(const lamp_command_t *cmd) {
+  taskENTER_CRITICAL(&s_mailbox_lock);
+  if (cmd->fields & LAMP_CMD_BRIGHTNESS) {
+    s_pending.brightness = cmd->brightness;
+    s_pending.transition_ms = cmd->transition_ms;
+    s_pending.easing = cmd->easing;
+  }
+  if (cmd->fields & LAMP_CMD_GEOMETRY) {
+    s_pending.layout = cmd->layout;
+    s_pending.pixel_format = cmd->pixel_format;
+  }
+  if (cmd->fields & LAMP_CMD_COLOR_MODE)
+    s_pending.color_mode = cmd->color_mode;
+  if (cmd->fields & LAMP_CMD_HSV)
+    s_pending.color = cmd->color;
+  if (cmd->fields & LAMP_CMD_KELVIN) {
+    s_pending.kelvin = cmd->kelvin;
+    s_pending.color_transition_ms = cmd->color_transition_ms;
+  }
+  if (cmd->fields & LAMP_CMD_NOTIFICATION)
+    s_pending.notification = cmd->notification;
+  s_pending.fields |= cmd->fields;
+  taskEXIT_CRITICAL(&s_mailbox_lock);
+
+  if (s_render_task)
+    xTaskNotifyGive(s_render_task);
+}
+
+static int take_pending_command(lamp_command_t *cmd) {
+  taskENTER_CRITICAL(&s_mailbox_lock);
+  *cmd = s_pending;
+  s_pending.fields = 0;
+  taskEXIT_CRITICAL(&s_mailbox_lock);
+  return cmd->fields != 0;
+}
+
+static uint32_t now_ms() {
+  return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static void render_task(void *arg) {
+  lamp_command_t cmd;
+  TickType_t period = pdMS_TO_TICKS(RENDER_FRAME_PERIOD_MS);
+  if (!period)
+    period = 1;
+  TickType_t next_frame = xTaskGetTickCount();
+  for (;;) {
+    // Commands posted before the task was started are handled right away
+    if (take_pending_command(&cmd))
+      render_lamp_command(&cmd, now_ms());
+    int animating = render_lamp_frame(now_ms());
+    // Sleep until the next frame while animating, otherwise until a command.
+    // Frames keep a fixed cadence, the time spent in the effects is not added
+    // to the period.
+    TickType_t now = xTaskGetTickCount();
+    TickType_t wait = portMAX_DELAY;
+    if (animating) {
+      if ((int32_t)(now - next_frame) >= 0) {
+        next_frame += period;
+        if ((int32_t)(now - next_frame) >= 0)
+          next_frame = now + period; // too slow, the missed frames are dropped
+      }
+      wait = next_frame - now;
+    }
+    ulTaskNotifyTake(pdTRUE, wait);
+    if (!animating)
+      next_frame = xTaskGetTickCount();
+  }
+}
+
+void start_render_task() {
+  if (s_render_task) {
+    ESP_LOGE(TAG, "Render task is already started");
+    return;
+  }
+  if (xTaskCreatePinnedToCore(render_task, "render", RENDER_TASK_STACK_SIZE,
+                              NULL, RENDER_TASK_PRIORITY, &s_render_task,
+                              RENDER_TASK_CORE) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create render task");
+    s_render_task = NULL;
+  }
+}
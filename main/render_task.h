@@ -0,0 +1,47 @@
+#ifndef __SMART_LAMP_RENDER_TASK_H__
+#define __SMART_LAMP_RENDER_TASK_H__
+
+#include "led_layout.h"
+#include "led_strip.h"
+#include "led_pixel.h"
+#include "led_transition.h"
+#include <stdint.h>
+
+/*
+ * Fields of lamp_command_t which carry a value. Commands posted before the
+ * render task picks them up are merged field by field, the latest value wins.
+ */
+#define LAMP_CMD_BRIGHTNESS (1 << 0)
+#define LAMP_CMD_GEOMETRY (1 << 1)
+#define LAMP_CMD_NOTIFICATION (1 << 2)
+#define LAMP_CMD_SEGMENTS (1 << 3) // segments were edited, carries no value
+#define LAMP_CMD_COLOR_MODE (1 << 4)
+#define LAMP_CMD_HSV (1 << 5)    // color of LED_COLOR_HSV
+#define LAMP_CMD_KELVIN (1 << 6) // kelvin with color_transition_ms
+
+/*
+ * Shown over the lamp light until it is cleared
+ */
+typedef enum {
+  LAMP_NOTIFICATION_NONE = 0,
+  LAMP_NOTIFICATION_UPLOAD, // a file is being uploaded
+} lamp_notification_t;
+
+typedef struct {
+  uint32_t fields; // LAMP_CMD_* mask
+  uint8_t brightness; // 0-255
+  led_layout_config_t layout; // geometry and wiring
+  led_pixel_format_t pixel_format;
+  uint32_t transition_ms; // fade to the new values, 0 to jump
+  led_easing_t easing;
+  lamp_notification_t notification;
+  led_color_mode_t color_mode;
+  led_hsv_t color;
+  uint16_t kelvin;
+  uint32_t color_transition_ms; // fade of the color temperature
+} lamp_command_t;
+
+void start_render_task();
+void post_lamp_command(const lamp_command_t *cmd);
+
+#endif
@@ -1,34 +1,57 @@
-#include "driver/rmt_encoder.h"
 #include "esp_err.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
-#include "esp_spiffs.h"
 #include "esp_system.h"
-#include "esp_vfs.h" // Для работы с файлами
 #include "globals.h"
 #include "http_parser.h"
+#include "led_strip.h"
 #include "led_strip_wrapper.h"
-#include "lwip/api.h"
-#include "lwip/err.h"
-#include "lwip/netdb.h"
-#include "lwip/sockets.h"
-#include "lwip/sys.h"
 #include "mdns.h"
+#include "multipart.h"
+#include "web_assets.h"
+#include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
 
 #define BUFFER_SIZE 1024
 #define MAX_BODY_SIZE 1024
 #define SCRATCH_BUFSIZE (8192)  // Буфер для чтения данных
 #define UPLOAD_BUFFER_SIZE 4096 // Уменьшаем буфер до 4KB
+#define MAX_TRANSITION_MS 60000 // longer fades are cut to this
 #define MIN(a, b)                                                              \
   ((a) < (b) ? (a) : (b)) // Добавляем макрос MIN
                           //
 static const char *TAG = "http_server";
 static char *cached_index_html = NULL;
 static size_t cached_index_len = 0;
+static int cached_index_gzip = 0; // cached_index_html is index.html.gz
+static uint32_t cached_index_crc = 0; // CRC-32 of the contents, for ETag
+
+#define INDEX_HTML_PATH SPIFFS_BASE_PATH "/index.html"
+#define INDEX_HTML_GZ_PATH SPIFFS_BASE_PATH "/index.html.gz"
+#define WEB_MANIFEST_SIZE 8
+#define WEB_FILE_NAME_SIZE 32 // SPIFFS_OBJ_NAME_LEN
+
+/*
+ * Files in SPIFFS, listed once at start and kept up to date by the upload, so
+ * requests never have to probe the filesystem (opening a SPIFFS file scans
+ * its whole object index)
+ */
+typedef struct {
+  char name[WEB_FILE_NAME_SIZE];
+  size_t size;
+} web_file_t;
+
+static web_file_t web_manifest[WEB_MANIFEST_SIZE];
+static int web_manifest_count = 0;
+// Filesystem calls made by the server, and by the last GET / alone
+static uint32_t fs_ops = 0;
+static uint32_t last_get_fs_ops = 0;
 
 esp_err_t init_mdns() {
   esp_err_t err = mdns_init();
@@ -62,51 +85,147 @@ esp_err_t init_mdns() {
   return ESP_OK;
 }
 
-esp_err_t cache_index_html() {
-  FILE *f = fopen("/spiffs/index.html", "rb");
-  if (!f) {
-    ESP_LOGE(TAG, "Failed to open index.html");
-    return ESP_FAIL;
-  }
+/*
+ * Reads the whole file into a new buffer, returns NULL if it can't
+ */
+static char *read_file(const char *path, size_t *len) {
+  fs_ops++;
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
 
   // Получаем размер файла
   fseek(f, 0, SEEK_END);
-  cached_index_len = ftell(f);
+  long size = ftell(f);
   fseek(f, 0, SEEK_SET);
 
   // Выделяем память (обычная куча, не DMA)
-  cached_index_html = malloc(cached_index_len + 1);
-  if (!cached_index_html) {
+  char *data = size >= 0 ? malloc(size + 1) : NULL;
+  if (!data) {
     fclose(f);
     ESP_LOGE(TAG, "Failed to allocate cache buffer");
-    return ESP_FAIL;
+    return NULL;
   }
 
-  size_t read_bytes = fread(cached_index_html, 1, cached_index_len, f);
+  size_t read_bytes = fread(data, 1, size, f);
   fclose(f);
+  if (read_bytes != (size_t)size) {
+    free(data);
+    ESP_LOGE(TAG, "Failed to read %s", path);
+    return NULL;
+  }
+  data[size] = '\0';
+  *len = size;
+  return data;
+}
+
+static web_file_t *find_web_file(const char *name) {
+  for (int i = 0; i < web_manifest_count; i++) {
+    if (!strcmp(web_manifest[i].name, name))
+      return &web_manifest[i];
+  }
+  return NULL;
+}
 
-  if (read_bytes != cached_index_len) {
-    free(cached_index_html);
-    cached_index_html = NULL;
-    ESP_LOGE(TAG, "Failed to read index.html");
+static void add_web_file(const char *name, size_t size) {
+  web_file_t *file = find_web_file(name);
+  if (!file) {
+    if (web_manifest_count == WEB_MANIFEST_SIZE) {
+      ESP_LOGW(TAG, "Manifest is full, %s is not listed", name);
+      return;
+    }
+    file = &web_manifest[web_manifest_count++];
+    strncpy(file->name, name, sizeof(file->name) - 1);
+    file->name[sizeof(file->name) - 1] = '\0';
+  }
+  file->size = size;
+}
+
+static void remove_web_file(const char *name) {
+  web_file_t *file = find_web_file(name);
+  if (!file)
+    return;
+  char path[sizeof(SPIFFS_BASE_PATH) + WEB_FILE_NAME_SIZE + 1];
+  snprintf(path, sizeof(path), SPIFFS_BASE_PATH "/%s", name);
+  fs_ops++;
+  unlink(path);
+  *file = web_manifest[--web_manifest_count];
+}
+
+static void load_web_manifest() {
+  fs_ops++;
+  DIR *dir = opendir(SPIFFS_BASE_PATH);
+  if (!dir) {
+    ESP_LOGW(TAG, "Failed to list " SPIFFS_BASE_PATH);
+    return;
+  }
+  web_manifest_count = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir))) {
+    // .upload остаётся от оборванной загрузки
+    if (entry->d_type == DT_DIR || entry->d_name[0] == '.')
+      continue;
+    char path[sizeof(SPIFFS_BASE_PATH) + WEB_FILE_NAME_SIZE + 1];
+    struct stat st;
+    snprintf(path, sizeof(path), SPIFFS_BASE_PATH "/%.*s",
+             WEB_FILE_NAME_SIZE - 1, entry->d_name);
+    fs_ops++;
+    if (stat(path, &st) == 0)
+      add_web_file(entry->d_name, st.st_size);
+  }
+  closedir(dir);
+  ESP_LOGI(TAG, "%d files in " SPIFFS_BASE_PATH, web_manifest_count);
+}
+
+/*
+ * Caches index.html.gz if it was uploaded, index.html otherwise. The
+ * compressed page is several times smaller, in flash, in RAM and on air.
+ * index.html is kept next to it for clients which refuse gzip.
+ */
+esp_err_t cache_index_html() {
+  free(cached_index_html);
+  cached_index_html = NULL;
+  cached_index_gzip = find_web_file("index.html.gz") != NULL;
+  if (cached_index_gzip)
+    cached_index_html = read_file(INDEX_HTML_GZ_PATH, &cached_index_len);
+  else if (find_web_file("index.html"))
+    cached_index_html = read_file(INDEX_HTML_PATH, &cached_index_len);
+  if (!cached_index_html) {
+    ESP_LOGE(TAG, "Failed to cache index.html");
     return ESP_FAIL;
   }
 
-  cached_index_html[cached_index_len] = '\0';
-  ESP_LOGI(TAG, "Cached index.html (%d bytes)", (int)cached_index_len);
+  // Хэш считается один раз, а не на каждый запрос
+  cached_index_crc = web_assets_crc32(0, (const uint8_t *)cached_index_html,
+                                      cached_index_len);
+  ESP_LOGI(TAG, "Cached %s (%d bytes)",
+           cached_index_gzip ? "index.html.gz" : "index.html",
+           (int)cached_index_len);
   return ESP_OK;
 }
 
 int check_webapp_uploaded() {
-  FILE *f = NULL;
-  // Open renamed file for reading
-  ESP_LOGI(TAG, "Check index.html exists");
-  f = fopen("/spiffs/index.html", "r");
-  if (f == NULL) {
+  return find_web_file("index.html.gz") || find_web_file("index.html");
+}
+
+/*
+ * Returns 1 if the Accept-Encoding header of the request allows gzip
+ */
+static int accepts_gzip(httpd_req_t *req) {
+  char accept_encoding[128];
+  if (httpd_req_get_hdr_value_str(req, "Accept-Encoding", accept_encoding,
+                                  sizeof(accept_encoding)) != ESP_OK)
     return 0;
-  }
-  fclose(f);
-  return 1;
+  const char *gzip = strstr(accept_encoding, "gzip");
+  if (!gzip)
+    return 0;
+  // gzip;q=0 отказывается от сжатия
+  const char *param = gzip + strlen("gzip");
+  param += strspn(param, " ");
+  if (*param != ';')
+    return 1;
+  param += 1 + strspn(param + 1, " ");
+  return strncmp(param, "q=", 2) || strtod(param + 2, NULL) > 0;
 }
 
 const char *default_html_response =
@@ -124,212 +243,735 @@ const char *default_html_response =
     "</body>\n"
     "</html>";
 
-esp_err_t get_handler(httpd_req_t *req) {
+/*
+ * Returns 1 if If-None-Match of the request lists etag (or is "*")
+ */
+static int etag_matches(httpd_req_t *req, const char *etag) {
+  char if_none_match[128];
+  if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match,
+                                  sizeof(if_none_match)) != ESP_OK)
+    return 0;
+  // W/"..." сравнивается слабо, как и положено для If-None-Match
+  return strstr(if_none_match, etag) || !strcmp(if_none_match, "*");
+}
+
+/*
+ * The page URL is not versioned, so browsers keep it but revalidate on every
+ * load: an unchanged page costs a 304 without a body
+ */
+static esp_err_t send_index_html(httpd_req_t *req, const void *data,
+                                 size_t len, int gzip, uint32_t crc) {
+  // The compressed and the plain page are different representations
+  char etag[24];
+  snprintf(etag, sizeof(etag), "\"%08lx-%lx%s\"", (unsigned long)crc,
+           (unsigned long)len, gzip ? "-gz" : "");
+  httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+  httpd_resp_set_hdr(req, "ETag", etag);
+  // Без несжатого варианта страница уходит сжатой и тем, кто gzip не просил:
+  // так можно (RFC 9110, 12.5.3), а 406 оставил бы их совсем без страницы
+  if (gzip)
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+  if (etag_matches(req, etag)) {
+    httpd_resp_set_status(req, "304 Not Modified");
+    return httpd_resp_send(req, NULL, 0);
+  }
+  return httpd_resp_send(req, data, len);
+}
+
+/*
+ * Streams index.html from SPIFFS, for the rare clients which refuse the cached
+ * index.html.gz. The plain page is not cached, it would double the heap taken.
+ */
+static esp_err_t send_index_file(httpd_req_t *req) {
+  fs_ops++;
+  FILE *f = fopen(INDEX_HTML_PATH, "rb");
+  char *buf = f ? malloc(SCRATCH_BUFSIZE) : NULL;
+  if (!buf) {
+    if (f)
+      fclose(f);
+    ESP_LOGE(TAG, "Failed to open " INDEX_HTML_PATH);
+    return httpd_resp_send_500(req);
+  }
+  httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+  esp_err_t err = ESP_OK;
+  size_t len;
+  while (err == ESP_OK && (len = fread(buf, 1, SCRATCH_BUFSIZE, f)) > 0) {
+    fs_ops++;
+    err = httpd_resp_send_chunk(req, buf, len);
+  }
+  fclose(f);
+  free(buf);
+  if (err != ESP_OK)
+    return err;
+  return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t send_index_page(httpd_req_t *req) {
   const int is_webapp_uploaded = check_webapp_uploaded();
   if (!is_webapp_uploaded) {
+    // Страница из раздела assets отдаётся прямо из флеша, без копии в куче
+    web_asset_t asset;
+    if (find_web_asset("/index.html", accepts_gzip(req), &asset) ||
+        find_web_asset("/index.html", 1, &asset))
+      return send_index_html(req, asset.data, asset.size,
+                             asset.flags & WEB_ASSET_GZIP, asset.crc32);
     ESP_LOGW(TAG, "Web application not yet uploaded");
     return httpd_resp_send(req, default_html_response,
                            strlen(default_html_response));
   }
-  if (!cached_index_html) {
-    cache_index_html(); // Trying to cache existing file
-  }
+  if (cached_index_gzip && find_web_file("index.html") && !accepts_gzip(req))
+    return send_index_file(req);
+  // Кэш заполняется при старте и после загрузки, здесь файлы не читаются
   if (!cached_index_html) {
     ESP_LOGE(TAG, "Cache not initialized");
     return httpd_resp_send_500(req);
   }
+  return send_index_html(req, cached_index_html, cached_index_len,
+                         cached_index_gzip, cached_index_crc);
+}
 
-  return httpd_resp_send(req, cached_index_html, cached_index_len);
+esp_err_t get_handler(httpd_req_t *req) {
+  uint32_t start_fs_ops = fs_ops;
+  esp_err_t err = send_index_page(req);
+  last_get_fs_ops = fs_ops - start_fs_ops;
+  if (last_get_fs_ops)
+    ESP_LOGW(TAG, "GET / made %lu filesystem calls",
+             (unsigned long)last_get_fs_ops);
+  return err;
 }
 
-esp_err_t upload_handler(httpd_req_t *req) {
-  char *buf = malloc(UPLOAD_BUFFER_SIZE);
-  if (!buf) {
-    httpd_resp_send_500(req);
-    return ESP_FAIL;
+#define UPLOAD_TMP_PATH SPIFFS_BASE_PATH "/.upload"
+
+/*
+ * State of one /upload request. Every file is written to UPLOAD_TMP_PATH and
+ * renamed when its part is complete, so a broken upload leaves the previous
+ * file (and the manifest) intact.
+ */
+typedef struct {
+  multipart_parser_t parser;
+  FILE *fd;
+  char filename[WEB_FILE_NAME_SIZE];
+  size_t written;
+  size_t total_written;
+  int files;
+  int index_changed;
+  uint8_t buf[UPLOAD_BUFFER_SIZE];
+} upload_t;
+
+static int is_safe_filename(const char *name) {
+  return name[0] && name[0] != '.' && strlen(name) < WEB_FILE_NAME_SIZE &&
+         !strpbrk(name, "/\\");
+}
+
+static int upload_part_begin(void *ctx, const char *name,
+                             const char *filename) {
+  upload_t *upload = ctx;
+  if (!filename[0])
+    return 0; // обычное поле формы, не файл
+  if (!is_safe_filename(filename)) {
+    ESP_LOGE(TAG, "Invalid file name '%s'", filename);
+    return 1;
+  }
+  strcpy(upload->filename, filename);
+  upload->written = 0;
+  fs_ops++;
+  upload->fd = fopen(UPLOAD_TMP_PATH, "wb");
+  if (!upload->fd) {
+    ESP_LOGE(TAG, "Failed to open file " UPLOAD_TMP_PATH);
+    return 1;
+  }
+  return 0;
+}
+
+static int upload_part_data(void *ctx, const uint8_t *data, size_t len) {
+  upload_t *upload = ctx;
+  if (!upload->fd)
+    return 0;
+  if (fwrite(data, 1, len, upload->fd) != len) {
+    ESP_LOGE(TAG, "Failed to write %s", upload->filename);
+    return 1;
+  }
+  upload->written += len;
+  return 0;
+}
+
+static int upload_part_end(void *ctx) {
+  upload_t *upload = ctx;
+  if (!upload->fd)
+    return 0;
+  int failed = fclose(upload->fd) != 0;
+  upload->fd = NULL;
+  char filepath[sizeof(SPIFFS_BASE_PATH) + WEB_FILE_NAME_SIZE + 1];
+  snprintf(filepath, sizeof(filepath), SPIFFS_BASE_PATH "/%s",
+           upload->filename);
+  // SPIFFS не переименовывает поверх существующего файла
+  fs_ops += 2;
+  unlink(filepath);
+  if (failed || rename(UPLOAD_TMP_PATH, filepath) != 0) {
+    ESP_LOGE(TAG, "Failed to store %s", upload->filename);
+    // Прежний файл уже удалён
+    remove_web_file(upload->filename);
+    upload->index_changed = 1;
+    return 1;
   }
+  ESP_LOGI(TAG, "File %s uploaded, size: %d bytes", upload->filename,
+           (int)upload->written);
+  add_web_file(upload->filename, upload->written);
+  // Оба варианта страницы остаются: несжатый нужен клиентам без gzip
+  if (!strcmp(upload->filename, "index.html") ||
+      !strcmp(upload->filename, "index.html.gz"))
+    upload->index_changed = 1;
+  upload->total_written += upload->written;
+  upload->files++;
+  return 0;
+}
+
+static const multipart_callbacks_t upload_callbacks = {
+    .on_part_begin = upload_part_begin,
+    .on_part_data = upload_part_data,
+    .on_part_end = upload_part_end,
+};
 
-  char filename[128] = {0};
-  FILE *fd = NULL;
+static int64_t now_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * multipart/form-data with one or more files, parsed as it arrives: parts and
+ * boundaries may be split between chunks anywhere
+ */
+static esp_err_t receive_upload(httpd_req_t *req) {
   const char *fail_resp = "{\"result\": false}";
   const char *success_resp = "{\"result\": true}";
-  char boundary[70] = {0};
-  bool file_complete = false;
-  size_t total_written = 0;
 
   // Получаем boundary из Content-Type
   char content_type[128];
+  char boundary[MULTIPART_BOUNDARY_MAX + 1];
   if (httpd_req_get_hdr_value_str(req, "Content-Type", content_type,
-                                  sizeof(content_type)) != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to get Content-Type header");
-    free(buf);
+                                  sizeof(content_type)) != ESP_OK ||
+      !multipart_boundary(content_type, boundary, sizeof(boundary))) {
+    ESP_LOGE(TAG, "Boundary not found in Content-Type");
     httpd_resp_send(req, fail_resp, strlen(fail_resp));
     return ESP_FAIL;
   }
+  ESP_LOGI(TAG, "Boundary: %s", boundary);
 
-  char *boundary_start = strstr(content_type, "boundary=");
-  if (!boundary_start) {
-    ESP_LOGE(TAG, "Boundary not found in Content-Type");
-    free(buf);
-    httpd_resp_send(req, fail_resp, strlen(fail_resp));
+  upload_t *upload = calloc(1, sizeof(*upload));
+  if (!upload) {
+    httpd_resp_send_500(req);
     return ESP_FAIL;
   }
-  strncpy(boundary, boundary_start + 9, sizeof(boundary) - 1);
-  ESP_LOGI(TAG, "Boundary: %s", boundary);
+  multipart_parser_init(&upload->parser, boundary, &upload_callbacks, upload);
 
   // Обработка данных
+  int64_t start_us = now_us();
   int remaining = req->content_len;
-  bool is_first_chunk = true;
-  char *data_start = NULL;
-  size_t data_len = 0;
-
-  while (remaining > 0 && !file_complete) {
-    int received = httpd_req_recv(req, buf, MIN(remaining, UPLOAD_BUFFER_SIZE));
+  int ok = 1;
+  while (remaining > 0 && ok) {
+    int received = httpd_req_recv(req, (char *)upload->buf,
+                                  MIN(remaining, UPLOAD_BUFFER_SIZE));
     if (received <= 0) {
       ESP_LOGE(TAG, "Receive failed or connection closed");
-      if (fd)
-        fclose(fd);
-      free(buf);
-      httpd_resp_send(req, fail_resp, strlen(fail_resp));
-      return ESP_FAIL;
-    }
-
-    if (is_first_chunk) {
-      // Парсинг имени файла из заголовков
-      char *filename_start = strstr(buf, "filename=\"");
-      if (!filename_start) {
-        ESP_LOGE(TAG, "Filename not found in headers");
-        free(buf);
-        httpd_resp_send(req, fail_resp, strlen(fail_resp));
-        return ESP_FAIL;
-      }
-      filename_start += 10;
-      char *filename_end = strchr(filename_start, '"');
-      if (!filename_end) {
-        ESP_LOGE(TAG, "Malformed filename header");
-        free(buf);
-        httpd_resp_send(req, fail_resp, strlen(fail_resp));
-        return ESP_FAIL;
-      }
-      strncpy(filename, filename_start, filename_end - filename_start);
-
-      // Открываем файл в SPIFFS
-      char filepath[256];
-      snprintf(filepath, sizeof(filepath), "/spiffs/%s", filename);
-      fd = fopen(filepath, "wb");
-      if (!fd) {
-        ESP_LOGE(TAG, "Failed to open file %s", filepath);
-        free(buf);
-        httpd_resp_send(req, fail_resp, strlen(fail_resp));
-        return ESP_FAIL;
-      }
-
-      // Находим начало данных файла (после \r\n\r\n)
-      data_start = strstr(buf, "\r\n\r\n");
-      if (data_start) {
-        data_start += 4;
-        data_len = buf + received - data_start;
-      } else {
-        data_start = buf;
-        data_len = received;
-      }
-      is_first_chunk = false;
-    } else {
-      data_start = buf;
-      data_len = received;
-    }
-
-    // Ищем boundary в текущем чанке
-    char *boundary_pos =
-        memmem(data_start, data_len, boundary, strlen(boundary));
-    if (boundary_pos) {
-      // Нашли конец файла
-      size_t to_write = boundary_pos - data_start - 2; // Учитываем \r\n
-      fwrite(data_start, 1, to_write, fd);
-      total_written += to_write;
-      file_complete = true;
-      ESP_LOGI(TAG, "File end detected at %d bytes", (int)to_write);
-    } else {
-      // Записываем весь чанк (если boundary не найден)
-      fwrite(data_start, 1, data_len, fd);
-      total_written += data_len;
+      ok = 0;
+      break;
     }
-
+    ok = multipart_parser_feed(&upload->parser, upload->buf, received);
     remaining -= received;
   }
+  if (ok && !multipart_parser_done(&upload->parser)) {
+    ESP_LOGE(TAG, "Multipart body is incomplete");
+    ok = 0;
+  }
+  if (upload->fd) {
+    // Оборванная часть: временный файл больше не нужен
+    fclose(upload->fd);
+    fs_ops++;
+    unlink(UPLOAD_TMP_PATH);
+  }
 
-  if (fd)
-    fclose(fd);
-  free(buf);
-
-  if (file_complete) {
-    ESP_LOGI(TAG, "File %s uploaded successfully, size: %d bytes", filename,
-             (int)total_written);
+  int64_t elapsed_us = now_us() - start_us;
+  ESP_LOGI(TAG, "Received %d bytes in %d ms (%d KB/s), %d files",
+           (int)req->content_len, (int)(elapsed_us / 1000),
+           (int)(elapsed_us ? (int64_t)req->content_len * 1000000 /
+                                   elapsed_us / 1024
+                            : 0),
+           upload->files);
+  if (upload->index_changed)
     cache_index_html();
-    httpd_resp_send(req, success_resp, strlen(success_resp));
-    return ESP_OK;
-  } else {
-    ESP_LOGE(TAG, "File upload incomplete");
+  ok = ok && upload->files > 0;
+  free(upload);
+
+  if (!ok) {
+    ESP_LOGE(TAG, "File upload failed");
     httpd_resp_send(req, fail_resp, strlen(fail_resp));
     return ESP_FAIL;
   }
+  httpd_resp_send(req, success_resp, strlen(success_resp));
+  return ESP_OK;
+}
+
+esp_err_t upload_handler(httpd_req_t *req) {
+  // Лампа пульсирует, пока идёт загрузка
+  set_lamp_notification(LAMP_NOTIFICATION_UPLOAD);
+  esp_err_t err = receive_upload(req);
+  set_lamp_notification(LAMP_NOTIFICATION_NONE);
+  return err;
+}
+
+/*
+ * Value of form field key ("name="), NULL if it is missing. Only whole names
+ * match, value= is not found inside saturation=.
+ */
+static const char *find_form_field(const char *body, const char *key) {
+  size_t key_len = strlen(key);
+  for (const char *field = body; field; field = strchr(field, '&')) {
+    if (*field == '&')
+      field++;
+    if (!strncmp(field, key, key_len))
+      return field + key_len;
+  }
+  return NULL;
+}
+
+/*
+ * Returns the integer value of form field key, or fallback if it is missing
+ */
+static int get_form_int(const char *body, const char *key, int fallback) {
+  const char *value = find_form_field(body, key);
+  return value ? atoi(value) : fallback;
+}
+
+/*
+ * Copies the value of form field key into out, returns 0 if it is missing
+ */
+static int get_form_str(const char *body, const char *key, char *out,
+                        size_t size) {
+  const char *value = find_form_field(body, key);
+  if (!value || !size)
+    return 0;
+  size_t len = strcspn(value, "&");
+  if (len >= size)
+    len = size - 1;
+  memcpy(out, value, len);
+  out[len] = '\0';
+  return 1;
 }
 
 esp_err_t get_control_handler(httpd_req_t *req) {
-  char resp[128];
+  char resp[192];
+  led_segment_t segments[LED_MAX_SEGMENTS];
+  int count = get_lamp_segments(segments);
+
+  // Сегменты отправляются частями, без большого буфера на стеке
+  static const char *color_modes[] = {"warm", "hsv", "kelvin"};
+  lamp_settings_t settings;
+  get_lamp_settings(&settings);
+  const led_hsv_t *color = &settings.color;
+  snprintf(resp, sizeof(resp),
+           "{ \"data\": { \"brightness\": %d, \"mode\": \"%s\", "
+           "\"hue\": %d, \"saturation\": %d, \"value\": %d, "
+           "\"kelvin\": %d, \"segments\": [",
+           scale_0_255_to_0_100_fast(settings.brightness),
+           color_modes[settings.color_mode],
+           (color->h * 360 + 128) / 256, scale_0_255_to_0_100_fast(color->s),
+           scale_0_255_to_0_100_fast(color->v), settings.kelvin);
+  httpd_resp_send_chunk(req, resp, strlen(resp));
+  for (int i = 0; i < count; i++) {
+    const led_segment_t *segment = &segments[i];
+    snprintf(resp, sizeof(resp),
+             "%s{ \"name\": \"%s\", \"start\": %d, \"length\": %d, "
+             "\"reverse\": %d, \"brightness\": %d, \"effect\": \"%s\", "
+             "\"color\": \"%02x%02x%02x%02x\" }",
+             i ? ", " : "", segment->name, segment->start, segment->length,
+             segment->reverse,
+             scale_0_255_to_0_100_fast(segment->brightness),
+             led_effect_get(segment->effect)->name, segment->color.r,
+             segment->color.g, segment->color.b, segment->color.w);
+    httpd_resp_send_chunk(req, resp, strlen(resp));
+  }
+  const char *end = "] } }";
+  httpd_resp_send_chunk(req, end, strlen(end));
+  return httpd_resp_send_chunk(req, NULL, 0);
+}
 
-  snprintf(resp, sizeof(resp), "{ \"data\": { \"brightness\": %d } }",
-           scale_0_255_to_0_100_fast(lamp_state.brightness));
+/*
+ * Parses rrggbb or rrggbbww, returns 0 if the value is malformed
+ */
+static int parse_hex_color(const char *value, led_color_t *color) {
+  size_t len = strlen(value);
+  if ((len != 6 && len != 8) || strspn(value, "0123456789abcdefABCDEF") != len)
+    return 0;
+  uint32_t rgbw = strtoul(value, NULL, 16);
+  if (len == 6)
+    rgbw <<= 8;
+  *color = (led_color_t){
+      .r = rgbw >> 24, .g = rgbw >> 16, .b = rgbw >> 8, .w = rgbw};
+  return 1;
+}
+
+/*
+ * Lamp color from hue (0-359 degrees) with saturation and value (0-100), r, g
+ * and b (0-255), color (rrggbb) or kelvin. Returns 0 if there is none, -1 if
+ * it is malformed.
+ */
+static int get_form_color(const char *body, led_hsv_t *hsv) {
+  char color_str[12];
+  led_color_t rgb = {0};
+  if (find_form_field(body, "hue=")) {
+    int hue = get_form_int(body, "hue=", 0);
+    int saturation = get_form_int(body, "saturation=", 100);
+    int value = get_form_int(body, "value=", 100);
+    if (hue < 0 || hue >= 360 || saturation < 0 || saturation > 100 ||
+        value < 0 || value > 100)
+      return -1;
+    *hsv = (led_hsv_t){.h = hue * 256 / 360,
+                       .s = scale_0_100_to_0_255_fast(saturation),
+                       .v = scale_0_100_to_0_255_fast(value)};
+    return 1;
+  }
+  if (find_form_field(body, "r=") || find_form_field(body, "g=") ||
+      find_form_field(body, "b=")) {
+    int r = get_form_int(body, "r=", 0);
+    int g = get_form_int(body, "g=", 0);
+    int b = get_form_int(body, "b=", 0);
+    if (r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255)
+      return -1;
+    rgb = (led_color_t){.r = r, .g = g, .b = b};
+  } else if (get_form_str(body, "color=", color_str, sizeof(color_str))) {
+    if (strlen(color_str) != 6 || !parse_hex_color(color_str, &rgb))
+      return -1;
+  } else if (find_form_field(body, "kelvin=")) {
+    int kelvin = get_form_int(body, "kelvin=", 0);
+    if (kelvin < LED_KELVIN_MIN || kelvin > LED_KELVIN_MAX)
+      return -1;
+    rgb = led_kelvin_to_rgb(kelvin);
+  } else {
+    return 0;
+  }
+  *hsv = led_rgb_to_hsv(rgb);
+  return 1;
+}
+
+/*
+ * segment=name with any of start, length, reverse, brightness (0-100), effect
+ * (a name from /api/effects) and color (rrggbb or rrggbbww, or any form of
+ * get_form_color), or delete=1.
+ * Missing fields keep their values, a new segment covers the whole strip with
+ * the lamp light.
+ */
+static esp_err_t segment_control(httpd_req_t *req, const char *buf,
+                                 const char *name) {
+  const char *fail_resp = "{\"result\": false}";
+  led_segment_t segments[LED_MAX_SEGMENTS];
+  int count = get_lamp_segments(segments);
+  int index = led_segment_find(segments, count, name);
+  int ok;
+
+  if (get_form_int(buf, "delete=", 0)) {
+    ok = delete_lamp_segment(name);
+  } else {
+    lamp_settings_t settings;
+    get_lamp_settings(&settings);
+    led_segment_t segment = {
+        .length = settings.layout.cols * settings.layout.rows,
+        .brightness = 255,
+        .color = get_warm_light(led_pixel_ops(settings.pixel_format), 255),
+    };
+    if (index >= 0)
+      segment = segments[index];
+    strncpy(segment.name, name, sizeof(segment.name) - 1);
+    int start = get_form_int(buf, "start=", segment.start);
+    int length = get_form_int(buf, "length=", segment.length);
+    segment.reverse = get_form_int(buf, "reverse=", segment.reverse) != 0;
+    if (find_form_field(buf, "brightness="))
+      segment.brightness =
+          scale_0_100_to_0_255_fast(get_form_int(buf, "brightness=", 100));
+    char color_str[12];
+    char effect_str[16];
+    ok = start >= 0 && start <= UINT16_MAX && length >= 0 &&
+         length <= UINT16_MAX;
+    if (get_form_str(buf, "effect=", effect_str, sizeof(effect_str))) {
+      int effect = led_effect_find(effect_str);
+      ok = ok && effect >= 0;
+      segment.effect = effect >= 0 ? effect : 0;
+    }
+    led_hsv_t hsv;
+    if (get_form_str(buf, "color=", color_str, sizeof(color_str))) {
+      ok = ok && parse_hex_color(color_str, &segment.color);
+    } else {
+      int found = get_form_color(buf, &hsv);
+      ok = ok && found >= 0;
+      if (found > 0)
+        segment.color = led_hsv_to_rgb(hsv);
+    }
+    segment.start = start;
+    segment.length = length;
+    ok = ok && set_lamp_segment(&segment);
+  }
+
+  if (!ok) {
+    ESP_LOGE(TAG, "Invalid segment request for '%s'", name);
+    httpd_resp_set_status(req, HTTPD_400);
+    httpd_resp_send(req, fail_resp, strlen(fail_resp));
+    return ESP_OK;
+  }
+  const char *resp = "{\"result\": true }";
   httpd_resp_send(req, resp, strlen(resp));
   return ESP_OK;
 }
 
-esp_err_t control_handler(httpd_req_t *req) {
+/*
+ * Transition length in ms from a form value, clamped to MAX_TRANSITION_MS.
+ * Returns -1 if it is negative or not a number.
+ */
+static int32_t parse_duration_ms(const char *value) {
+  char *end;
+  long duration = strtol(value, &end, 10);
+  if (end == value || (*end && *end != '&') || duration < 0)
+    return -1;
+  return duration > MAX_TRANSITION_MS ? MAX_TRANSITION_MS : duration;
+}
 
-  char buf[MAX_BODY_SIZE];
+static led_easing_t parse_easing(const char *value) {
+  if (!strncmp(value, "in_out", strlen("in_out")))
+    return LED_EASING_IN_OUT;
+  if (!strncmp(value, "in", strlen("in")))
+    return LED_EASING_IN;
+  if (!strncmp(value, "out", strlen("out")))
+    return LED_EASING_OUT;
+  return LED_EASING_LINEAR;
+}
+
+/*
+ * Reads the whole body into buf as a string, on error the response is
+ * already sent
+ */
+static esp_err_t read_request_body(httpd_req_t *req, char *buf, size_t size) {
   int ret, remaining = req->content_len;
+  size_t offset = 0;
 
-  if (remaining >= MAX_BODY_SIZE) {
+  if ((size_t)remaining >= size) {
     ESP_LOGE(TAG, "Request body too large (%d bytes), max allowed: %d bytes",
-             remaining, MAX_BODY_SIZE);
+             remaining, (int)size);
     char *large_resp = "Request body too large";
     httpd_resp_send(req, large_resp, strlen(large_resp));
     return ESP_FAIL;
   }
   // Читаем тело запроса
   while (remaining > 0) {
-    ret = httpd_req_recv(req, buf, MIN(remaining, MAX_BODY_SIZE));
+    ret = httpd_req_recv(req, buf + offset, remaining);
     if (ret <= 0) {
       ESP_LOGE(TAG, "Error receiving request body");
       httpd_resp_send_500(req);
       return ESP_FAIL;
     }
-    buf[ret] = '\0'; // Добавляем завершающий нуль
+    offset += ret;
     remaining -= ret;
   }
+  buf[offset] = '\0'; // Добавляем завершающий нуль
 
   ESP_LOGI(TAG, "Received body: %s", buf);
+  return ESP_OK;
+}
 
-  char *brightness_str = strstr(buf, "brightness=");
-  if (!brightness_str) {
+esp_err_t control_handler(httpd_req_t *req) {
+  char buf[MAX_BODY_SIZE];
+  if (read_request_body(req, buf, sizeof(buf)) != ESP_OK)
+    return ESP_FAIL;
+
+  // С segment= запрос относится к одной зоне ленты
+  char segment_name[LED_SEGMENT_NAME_SIZE];
+  if (get_form_str(buf, "segment=", segment_name, sizeof(segment_name)))
+    return segment_control(req, buf, segment_name);
+
+  // Цвет (hue/r/g/b/color, kelvin, mode=warm|hsv|kelvin) и яркость,
+  // хотя бы одно. Чего нет в запросе, остаётся у лампы как было.
+  led_hsv_t color;
+  led_color_mode_t mode = LED_COLOR_HSV;
+  char mode_str[8];
+  int has_mode = get_form_str(buf, "mode=", mode_str, sizeof(mode_str));
+  int has_kelvin = find_form_field(buf, "kelvin=") != NULL;
+  int kelvin = get_form_int(buf, "kelvin=", LED_KELVIN_MIN);
+  int has_color = has_kelvin ? 0 : get_form_color(buf, &color);
+  const char *brightness_str = find_form_field(buf, "brightness=");
+  const char *duration_str = find_form_field(buf, "duration=");
+  int32_t duration_ms = duration_str ? parse_duration_ms(duration_str) : 0;
+  if (duration_ms < 0) {
+    const char *fail_resp = "{\"result\": false}";
+    ESP_LOGE(TAG, "Invalid duration in request body");
+    httpd_resp_set_status(req, HTTPD_400);
+    httpd_resp_send(req, fail_resp, strlen(fail_resp));
+    return ESP_OK;
+  }
+  if (has_mode && !strcmp(mode_str, "warm"))
+    mode = LED_COLOR_WARM;
+  else if (has_kelvin || (has_mode && !strcmp(mode_str, "kelvin")))
+    mode = LED_COLOR_KELVIN;
+  if (has_color < 0 || kelvin < LED_KELVIN_MIN || kelvin > LED_KELVIN_MAX ||
+      (has_mode && mode == LED_COLOR_HSV && strcmp(mode_str, "hsv"))) {
+    const char *fail_resp = "{\"result\": false}";
+    ESP_LOGE(TAG, "Invalid color in request body");
+    httpd_resp_set_status(req, HTTPD_400);
+    httpd_resp_send(req, fail_resp, strlen(fail_resp));
+    return ESP_OK;
+  }
+  if (!brightness_str && !has_color && !has_kelvin && !has_mode) {
     char *bad_brightness = "Field 'brightness' not found in request body";
     ESP_LOGE(TAG, "Field 'brightness' not found in request body");
     httpd_resp_send(req, bad_brightness, strlen(bad_brightness));
     return ESP_FAIL;
   }
+  if (mode == LED_COLOR_KELVIN && has_kelvin)
+    set_lamp_kelvin(kelvin,
+                    duration_str ? duration_ms : DEFAULT_TRANSITION_MS);
+  else if (has_mode || has_color)
+    set_lamp_color(mode, has_color > 0 ? &color : NULL);
+
+  if (brightness_str) {
+    u_int8_t brightness = atoi(brightness_str); // Преобразуем строку в int
+
+    // Логируем значение brightness
+    ESP_LOGI(TAG, "Brightness value: %d", brightness);
+
+    // Необязательные параметры плавного перехода
+    const char *easing_str = find_form_field(buf, "easing=");
+    if (duration_str || easing_str) {
+      led_easing_t easing =
+          easing_str ? parse_easing(easing_str) : LED_EASING_IN_OUT;
+      set_brightness_transition(brightness, duration_ms, easing);
+    } else {
+      set_brightness_value(brightness);
+    }
+  }
+
+  const char *resp = "{\"result\": true }";
+  httpd_resp_send(req, resp, strlen(resp));
+
+  return ESP_OK;
+}
+
+/*
+ * Effects with their cost measured on this lamp, max_leds is how many pixels
+ * fit into one frame at the configured frame rate (0 until it was rendered)
+ */
+esp_err_t get_effects_handler(httpd_req_t *req) {
+  char resp[160];
+  const uint32_t frame_ns = 1000000000 / CONFIG_LED_FRAME_RATE;
+
+  snprintf(resp, sizeof(resp),
+           "{ \"data\": { \"frame_rate\": %d, \"effects\": [",
+           CONFIG_LED_FRAME_RATE);
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_send_chunk(req, resp, strlen(resp));
+  for (int i = 0; i < led_effect_count(); i++) {
+    const led_effect_t *effect = led_effect_get(i);
+    uint32_t cost_ns = led_effect_cost_ns(i);
+    snprintf(resp, sizeof(resp),
+             "%s{ \"name\": \"%s\", \"animated\": %d, "
+             "\"ns_per_pixel\": %lu, \"max_leds\": %lu }",
+             i ? ", " : "", effect->name, effect->animated,
+             (unsigned long)cost_ns,
+             (unsigned long)(cost_ns ? frame_ns / cost_ns : 0));
+    httpd_resp_send_chunk(req, resp, strlen(resp));
+  }
+  const char *end = "] } }";
+  httpd_resp_send_chunk(req, end, strlen(end));
+  return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t get_geometry_handler(httpd_req_t *req) {
+  char resp[320];
+  lamp_settings_t settings;
+  get_lamp_settings(&settings);
+  const led_layout_config_t *layout = &settings.layout;
+  const led_pixel_ops_t *ops = led_pixel_ops(settings.pixel_format);
+  static const int rotations[] = {0, 90, 180, 270};
+
+  snprintf(resp, sizeof(resp),
+           "{ \"data\": { \"cols\": %d, \"rows\": %d, "
+           "\"bytes_per_pixel\": %d, \"format\": \"%s\", "
+           "\"wiring\": \"%s\", \"rotation\": %d, \"mirror_x\": %d, "
+           "\"mirror_y\": %d } }",
+           layout->cols, layout->rows, ops->bytes_per_pixel, ops->name,
+           layout->wiring == LED_WIRING_SERPENTINE ? "serpentine" : "zigzag",
+           rotations[layout->rotation % LED_ROTATION_MAX], layout->mirror_x,
+           layout->mirror_y);
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_send(req, resp, strlen(resp));
+  return ESP_OK;
+}
+
+esp_err_t geometry_handler(httpd_req_t *req) {
+  char buf[MAX_BODY_SIZE];
+  const char *fail_resp = "{\"result\": false}";
+  if (read_request_body(req, buf, sizeof(buf)) != ESP_OK)
+    return ESP_FAIL;
 
-  // Смещаемся к значению после "brightness="
-  brightness_str += strlen("brightness=");
-  u_int8_t brightness = atoi(brightness_str); // Преобразуем строку в int
+  // Поля, которых нет в запросе, остаются прежними
+  lamp_settings_t settings;
+  get_lamp_settings(&settings);
+  led_layout_config_t layout = settings.layout;
+  int cols = get_form_int(buf, "cols=", layout.cols);
+  int rows = get_form_int(buf, "rows=", layout.rows);
+  // format= (grb, rgbw, ...) или устаревшее bytes_per_pixel= (3 или 4)
+  led_pixel_format_t pixel_format = settings.pixel_format;
+  char format_str[16];
+  if (get_form_str(buf, "format=", format_str, sizeof(format_str))) {
+    pixel_format = led_pixel_format_from_name(format_str);
+  } else if (find_form_field(buf, "bytes_per_pixel=")) {
+    int bytes_per_pixel = get_form_int(buf, "bytes_per_pixel=", 0);
+    pixel_format = bytes_per_pixel == 3   ? LED_PIXEL_GRB
+                   : bytes_per_pixel == 4 ? LED_PIXEL_GRBW
+                                          : LED_PIXEL_MAX;
+  }
+  int rotation = get_form_int(buf, "rotation=", layout.rotation * 90);
+  const char *wiring_str = find_form_field(buf, "wiring=");
+  if (wiring_str) {
+    layout.wiring = strncmp(wiring_str, "serpentine", strlen("serpentine"))
+                        ? LED_WIRING_ZIGZAG
+                        : LED_WIRING_SERPENTINE;
+  }
+  layout.mirror_x = get_form_int(buf, "mirror_x=", layout.mirror_x) != 0;
+  layout.mirror_y = get_form_int(buf, "mirror_y=", layout.mirror_y) != 0;
 
-  // Логируем значение brightness
-  ESP_LOGI(TAG, "Brightness value: %d", brightness);
+  if (cols < 0 || cols > UINT16_MAX || rows < 0 || rows > UINT16_MAX ||
+      rotation < 0 || rotation % 90) {
+    cols = rows = 0; // отклоняется ниже
+  }
+  layout.cols = cols;
+  layout.rows = rows;
+  layout.rotation = (rotation / 90) % LED_ROTATION_MAX;
 
-  set_brightness_value(brightness);
+  if (!set_led_geometry(&layout, pixel_format)) {
+    ESP_LOGE(TAG, "Geometry %dx%d, pixel format %d was not applied", cols,
+             rows, pixel_format);
+    httpd_resp_set_status(req, HTTPD_400);
+    httpd_resp_send(req, fail_resp, strlen(fail_resp));
+    return ESP_OK;
+  }
 
   const char *resp = "{\"result\": true }";
   httpd_resp_send(req, resp, strlen(resp));
+  return ESP_OK;
+}
+
+esp_err_t get_stats_handler(httpd_req_t *req) {
+  char resp[192];
+  led_output_stats_t stats;
+  get_output_stats(&stats);
 
+  snprintf(resp, sizeof(resp),
+           "{ \"data\": { \"frames_sent\": %lu, \"frames_skipped\": %lu, "
+           "\"fs_ops\": %lu, \"fs_ops_last_get\": %lu } }",
+           (unsigned long)stats.frames_sent,
+           (unsigned long)stats.frames_skipped, (unsigned long)fs_ops,
+           (unsigned long)last_get_fs_ops);
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_send(req, resp, strlen(resp));
   return ESP_OK;
 }
 
@@ -358,6 +1000,26 @@ httpd_uri_t uri_get_control = {.uri = "/api/control",
                                .handler = get_control_handler,
                                .user_ctx = NULL};
 
+httpd_uri_t uri_post_geometry = {.uri = "/api/geometry",
+                                 .method = HTTP_POST,
+                                 .handler = geometry_handler,
+                                 .user_ctx = NULL};
+
+httpd_uri_t uri_get_geometry = {.uri = "/api/geometry",
+                                .method = HTTP_GET,
+                                .handler = get_geometry_handler,
+                                .user_ctx = NULL};
+
+httpd_uri_t uri_get_stats = {.uri = "/api/stats",
+                             .method = HTTP_GET,
+                             .handler = get_stats_handler,
+                             .user_ctx = NULL};
+
+httpd_uri_t uri_get_effects = {.uri = "/api/effects",
+                               .method = HTTP_GET,
+                               .handler = get_effects_handler,
+                               .user_ctx = NULL};
+
 httpd_uri_t uri_favicon = {.uri = "/favicon.ico",
                            .method = HTTP_GET,
                            .handler = favicon_handler,
@@ -365,7 +1027,14 @@ httpd_uri_t uri_favicon = {.uri = "/favicon.ico",
 
 httpd_handle_t start_server() {
   init_mdns();
+  load_web_manifest();
+  if (check_webapp_uploaded())
+    cache_index_html();
   httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+  config.max_uri_handlers = 16; // по умолчанию только 8
+#if CONFIG_IDF_TARGET_LINUX
+  config.server_port = 8080; // 80 needs root on the host
+#endif
   httpd_handle_t server = NULL;
 
   if (httpd_start(&server, &config) == ESP_OK) {
@@ -374,6 +1043,10 @@ httpd_handle_t start_server() {
     httpd_register_uri_handler(server, &uri_post_upload);
     httpd_register_uri_handler(server, &uri_post_control);
     httpd_register_uri_handler(server, &uri_get_control);
+    httpd_register_uri_handler(server, &uri_post_geometry);
+    httpd_register_uri_handler(server, &uri_get_geometry);
+    httpd_register_uri_handler(server, &uri_get_stats);
+    httpd_register_uri_handler(server, &uri_get_effects);
   }
   return server;
 }
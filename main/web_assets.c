@@ -0,0 +1,157 @@
+#include "web_assets.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define WEB_ASSETS_FILE "assets.bin"
+#else
+#include "esp_partition.h"
+#endif
+
+#define WEB_ASSETS_PARTITION "assets"
+
+static const char *TAG = "web_assets";
+
+// Mapped image, NULL until init_web_assets() checked it
+static const uint8_t *assets_image = NULL;
+
+uint32_t web_assets_crc32(uint32_t crc, const uint8_t *data, size_t size) {
+  // Nibble table: 64 bytes of flash instead of 1 KB, fast enough for a check
+  // at boot
+  static const uint32_t table[16] = {
+      0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4,
+      0x4db26158, 0x5005713c, 0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+      0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+  };
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 15];
+    crc = (crc >> 4) ^ table[crc & 15];
+  }
+  return ~crc;
+}
+
+static const web_asset_entry_t *asset_entries(const uint8_t *image) {
+  return (const web_asset_entry_t *)(image + sizeof(web_assets_header_t));
+}
+
+/*
+ * Returns 1 if the image is complete and every entry lies inside it
+ */
+static int is_valid_image(const uint8_t *image, size_t mapped_size) {
+  const web_assets_header_t *header = (const web_assets_header_t *)image;
+  if (mapped_size < sizeof(*header) || header->magic != WEB_ASSETS_MAGIC) {
+    ESP_LOGW(TAG, "No asset image");
+    return 0;
+  }
+  size_t table_end =
+      sizeof(*header) + (size_t)header->count * sizeof(web_asset_entry_t);
+  if (header->version != WEB_ASSETS_VERSION || header->size > mapped_size ||
+      header->size < table_end) {
+    ESP_LOGE(TAG, "Unsupported asset image (version %d, %lu bytes)",
+             header->version, (unsigned long)header->size);
+    return 0;
+  }
+  if (web_assets_crc32(0, image + sizeof(*header),
+                       header->size - sizeof(*header)) != header->crc32) {
+    ESP_LOGE(TAG, "Asset image is corrupted");
+    return 0;
+  }
+  const web_asset_entry_t *entries = asset_entries(image);
+  for (int i = 0; i < header->count; i++) {
+    const web_asset_entry_t *entry = &entries[i];
+    if (!memchr(entry->path, '\0', sizeof(entry->path)) ||
+        entry->offset < table_end || entry->offset > header->size ||
+        entry->size > header->size - entry->offset) {
+      ESP_LOGE(TAG, "Asset %d is out of the image", i);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+#if CONFIG_IDF_TARGET_LINUX
+static const uint8_t *map_assets(size_t *size) {
+  int fd = open(WEB_ASSETS_FILE, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  void *image = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+    image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED)
+    return NULL;
+  *size = st.st_size;
+  return image;
+}
+#else
+static const uint8_t *map_assets(size_t *size) {
+  const esp_partition_t *partition = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+      WEB_ASSETS_PARTITION);
+  if (!partition)
+    return NULL;
+  const void *image = NULL;
+  esp_partition_mmap_handle_t handle;
+  // Отображается в адресное пространство, в куче ничего не копируется
+  esp_err_t err = esp_partition_mmap(partition, 0, partition->size,
+                                     ESP_PARTITION_MMAP_DATA, &image, &handle);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to map the asset partition: %s",
+             esp_err_to_name(err));
+    return NULL;
+  }
+  *size = partition->size;
+  return image;
+}
+#endif
+
+esp_err_t init_web_assets() {
+  size_t size = 0;
+  const uint8_t *image = map_assets(&size);
+  if (!image) {
+    ESP_LOGW(TAG, "Asset partition '%s' not found", WEB_ASSETS_PARTITION);
+    return ESP_ERR_NOT_FOUND;
+  }
+  // The mapping stays, it costs address space but no heap
+  if (!is_valid_image(image, size))
+    return ESP_ERR_INVALID_CRC;
+  assets_image = image;
+  ESP_LOGI(TAG, "Mapped %d assets (%lu bytes)",
+           ((const web_assets_header_t *)image)->count,
+           (unsigned long)((const web_assets_header_t *)image)->size);
+  return ESP_OK;
+}
+
+int find_web_asset(const char *path, int accept_gzip, web_asset_t *asset) {
+  if (!assets_image)
+    return 0;
+  const web_assets_header_t *header = (const web_assets_header_t *)assets_image;
+  const web_asset_entry_t *entries = asset_entries(assets_image);
+  const web_asset_entry_t *found = NULL;
+  for (int i = 0; i < header->count; i++) {
+    const web_asset_entry_t *entry = &entries[i];
+    if (strcmp(entry->path, path) ||
+        ((entry->flags & WEB_ASSET_GZIP) && !accept_gzip))
+      continue;
+    if (!found || (entry->flags & WEB_ASSET_GZIP))
+      found = entry;
+  }
+  if (!found)
+    return 0;
+  *asset = (web_asset_t){
+      .path = found->path,
+      .data = assets_image + found->offset,
+      .size = found->size,
+      .flags = found->flags,
+      .crc32 = found->crc32,
+  };
+  return 1;
+}
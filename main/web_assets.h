@@ -0,0 +1,61 @@
+#ifndef __SMART_LAMP_WEB_ASSETS_H__
+#define __SMART_LAMP_WEB_ASSETS_H__
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Packed image of the web files, written by tools/pack_assets.py into the
+ * "assets" partition. Little endian: header, path table, then the contents
+ * of the files, each aligned to 4 bytes. Offsets count from the image start.
+ */
+#define WEB_ASSETS_MAGIC 0x5453414c // "LAST"
+#define WEB_ASSETS_VERSION 1
+#define WEB_ASSET_PATH_SIZE 48
+#define WEB_ASSET_GZIP (1 << 0) // contents are gzip, sent with that encoding
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count; // entries in the path table
+  uint32_t size;  // of the whole image
+  uint32_t crc32; // of everything after the header
+} web_assets_header_t;
+
+typedef struct {
+  char path[WEB_ASSET_PATH_SIZE]; // "/index.html", zero terminated
+  uint32_t offset;
+  uint32_t size;
+  uint32_t flags; // WEB_ASSET_*
+  uint32_t crc32; // of the contents
+} web_asset_entry_t;
+
+/*
+ * A file of the image, data points into the mapped flash
+ */
+typedef struct {
+  const char *path;
+  const uint8_t *data;
+  size_t size;
+  uint32_t flags;
+  uint32_t crc32;
+} web_asset_t;
+
+/*
+ * Maps the asset partition and checks the image, a missing or broken image
+ * leaves no assets. On the host the image is assets.bin in the working
+ * directory.
+ */
+esp_err_t init_web_assets();
+/*
+ * Looks the path up in the image, the gzip variant wins if accept_gzip is
+ * set. Returns 0 if there is no such file.
+ */
+int find_web_asset(const char *path, int accept_gzip, web_asset_t *asset);
+/*
+ * CRC-32 of zlib and of the pack tool
+ */
+uint32_t web_assets_crc32(uint32_t crc, const uint8_t *data, size_t size);
+
+#endif
@@ -0,0 +1,15 @@
+# Color lookup tables for the component which includes this file, regenerated
+# when sdkconfig (color temperature) changes
+idf_build_get_property(python PYTHON)
+idf_build_get_property(sdkconfig_header SDKCONFIG_HEADER)
+set(color_tables_h ${CMAKE_CURRENT_BINARY_DIR}/color_tables.h)
+set(gen_color_tables ${CMAKE_CURRENT_LIST_DIR}/gen_color_tables.py)
+add_custom_command(OUTPUT ${color_tables_h}
+                   COMMAND ${python} ${gen_color_tables}
+                           --kelvin ${CONFIG_LAMP_WARM_WHITE_KELVIN}
+                           --output ${color_tables_h}
+                   DEPENDS ${gen_color_tables} ${sdkconfig_header}
+                   COMMENT "Generating color_tables.h")
+add_custom_target(color_tables DEPENDS ${color_tables_h})
+add_dependencies(${COMPONENT_LIB} color_tables)
+target_include_directories(${COMPONENT_LIB} PRIVATE ${CMAKE_CURRENT_BINARY_DIR})
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Generates color_tables.h: lookup tables of the lamp render path.
+
+  gen_color_tables.py --kelvin 2500 --output color_tables.h
+  gen_color_tables.py --kelvin-table --output kelvin_table.h
+"""
+import argparse
+import math
+
+KELVIN_FIRST = 1800
+KELVIN_LAST = 6500
+KELVIN_STEP = 100
+
+
+def cie1931(level):
+    """Perceived lightness (0-255) to linear LED output (0-255)."""
+    lightness = level * 100.0 / 255
+    if lightness <= 8:
+        y = lightness / 903.3
+    else:
+        y = ((lightness + 16) / 116) ** 3
+    return round(y * 255)
+
+
+def kelvin_to_rgb(kelvin):
+    """Approximation of the black body color by Tanner Helland, 0.0-1.0."""
+    t = kelvin / 100.0
+    if t <= 66:
+        r = 255
+        g = 99.4708025861 * math.log(t) - 161.1195681661
+    else:
+        r = 329.698727446 * (t - 60) ** -0.1332047592
+        g = 288.1221695283 * (t - 60) ** -0.0755148492
+    if t >= 66:
+        b = 255
+    elif t <= 19:
+        b = 0
+    else:
+        b = 138.5177312231 * math.log(t - 10) - 305.0447927307
+
+    def clamp(c):
+        return min(max(c, 0), 255) / 255.0
+
+    return clamp(r), clamp(g), clamp(b)
+
+
+def c_array(ctype, name, values):
+    lines = []
+    for i in range(0, len(values), 16):
+        lines.append('    ' + ', '.join(str(v) for v in values[i:i + 16]) + ',')
+    return 'static const %s %s[%d] = {\n%s\n};\n' % (ctype, name, len(values), '\n'.join(lines))
+
+
+def write_header(path, guard, defines, tables):
+    with open(path, 'w') as f:
+        f.write('// Generated by tools/gen_color_tables.py, do not edit\n')
+        f.write('#ifndef %s\n' % guard)
+        f.write('#define %s\n\n' % guard)
+        f.write('#include <stdint.h>\n\n')
+        for name, value in defines:
+            f.write('#define %s %d\n' % (name, value))
+        f.write('\n' + '\n'.join(tables))
+        f.write('\n#endif\n')
+
+
+def write_kelvin_table(path):
+    """Black body color every KELVIN_STEP, r g b per entry, 0-255."""
+    rgb = []
+    for kelvin in range(KELVIN_FIRST, KELVIN_LAST + 1, KELVIN_STEP):
+        rgb += [round(c * 255) for c in kelvin_to_rgb(kelvin)]
+    write_header(path, '__SMART_LAMP_KELVIN_TABLE_H__',
+                 [('KELVIN_TABLE_FIRST', KELVIN_FIRST),
+                  ('KELVIN_TABLE_LAST', KELVIN_LAST),
+                  ('KELVIN_TABLE_STEP', KELVIN_STEP)],
+                 [c_array('uint8_t', 'kelvin_table_rgb', rgb)])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--kelvin', type=int, help='warm white color temperature')
+    parser.add_argument('--kelvin-table', action='store_true',
+                        help='write the color temperature table instead')
+    parser.add_argument('--output', required=True)
+    args = parser.parse_args()
+
+    if args.kelvin_table:
+        write_kelvin_table(args.output)
+        return
+    if args.kelvin is None:
+        parser.error('--kelvin is required')
+
+    r, g, b = kelvin_to_rgb(args.kelvin)
+    tables = [
+        c_array('uint8_t', 'gamma_cie1931', [cie1931(i) for i in range(256)]),
+        c_array('uint8_t', 'warm_white_r', [round(i * r) for i in range(256)]),
+        c_array('uint8_t', 'warm_white_g', [round(i * g) for i in range(256)]),
+        c_array('uint8_t', 'warm_white_b', [round(i * b) for i in range(256)]),
+        c_array('uint8_t', 'percent_to_level', [(i * 255 + 50) // 100 for i in range(101)]),
+        c_array('uint8_t', 'level_to_percent', [(i * 100 + 127) // 255 for i in range(256)]),
+    ]
+    write_header(args.output, '__SMART_LAMP_COLOR_TABLES_H__',
+                 [('WARM_WHITE_KELVIN', args.kelvin)], tables)
+
+
+if __name__ == '__main__':
+    main()
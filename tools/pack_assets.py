@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""Packs web files into the image of the "assets" partition and checks it.
+
+  pack_assets.py pack --output assets.bin web/dist --exclude bundle.js
+  pack_assets.py verify assets.bin
+  pack_assets.py list assets.bin
+
+The layout is described in main/web_assets.h. A file.gz is stored under the
+path of file with the gzip flag, the lamp picks it for clients which accept
+gzip.
+"""
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = 0x5453414c  # "LAST"
+VERSION = 1
+PATH_SIZE = 48
+FLAG_GZIP = 1 << 0
+HEADER = struct.Struct('<IHHII')
+ENTRY = struct.Struct('<%dsIIII' % PATH_SIZE)
+ALIGN = 4
+
+
+def align(size):
+    return (size + ALIGN - 1) // ALIGN * ALIGN
+
+
+def collect(root, excludes):
+    files = []
+    for directory, _, names in os.walk(root):
+        for name in sorted(names):
+            full = os.path.join(directory, name)
+            rel = os.path.relpath(full, root).replace(os.sep, '/')
+            if rel in excludes or name in excludes:
+                continue
+            files.append((rel, full))
+    return sorted(files)
+
+
+def pack(args):
+    entries = []
+    for rel, full in collect(args.root, set(args.exclude)):
+        flags = 0
+        path = '/' + rel
+        if path.endswith('.gz'):
+            path = path[:-len('.gz')]
+            flags |= FLAG_GZIP
+        if len(path.encode()) >= PATH_SIZE:
+            sys.exit('%s: path is longer than %d bytes' % (path, PATH_SIZE - 1))
+        with open(full, 'rb') as f:
+            entries.append((path, flags, f.read()))
+
+    offset = HEADER.size + len(entries) * ENTRY.size
+    table = b''
+    contents = b''
+    for path, flags, data in entries:
+        offset = align(offset)
+        contents = contents.ljust(offset - HEADER.size - len(entries) * ENTRY.size, b'\0')
+        table += ENTRY.pack(path.encode(), offset, len(data), flags, zlib.crc32(data))
+        contents += data
+        offset += len(data)
+    body = table + contents
+    image = HEADER.pack(MAGIC, VERSION, len(entries), HEADER.size + len(body),
+                        zlib.crc32(body)) + body
+    if args.partition_size and len(image) > args.partition_size:
+        sys.exit('image is %d bytes, the partition only %d' % (len(image), args.partition_size))
+    with open(args.output, 'wb') as f:
+        f.write(image)
+    for path, flags, data in entries:
+        print('%-40s %8d%s' % (path, len(data), ' gzip' if flags & FLAG_GZIP else ''))
+    print('%s: %d files, %d bytes' % (args.output, len(entries), len(image)))
+
+
+def read_image(path):
+    """Returns the entries of the image, exits with the first error found."""
+    with open(path, 'rb') as f:
+        image = f.read()
+    if len(image) < HEADER.size:
+        sys.exit('%s: too short for a header' % path)
+    magic, version, count, size, crc = HEADER.unpack_from(image)
+    if magic != MAGIC:
+        sys.exit('%s: bad magic 0x%08x' % (path, magic))
+    if version != VERSION:
+        sys.exit('%s: unsupported version %d' % (path, version))
+    table_end = HEADER.size + count * ENTRY.size
+    if size > len(image) or size < table_end:
+        sys.exit('%s: size %d does not fit the file (%d bytes)' % (path, size, len(image)))
+    if zlib.crc32(image[HEADER.size:size]) != crc:
+        sys.exit('%s: image CRC mismatch' % path)
+    entries = []
+    for i in range(count):
+        raw_path, offset, length, flags, entry_crc = ENTRY.unpack_from(image, HEADER.size + i * ENTRY.size)
+        if b'\0' not in raw_path:
+            sys.exit('%s: entry %d path is not terminated' % (path, i))
+        name = raw_path.split(b'\0', 1)[0].decode()
+        if offset < table_end or offset + length > size:
+            sys.exit('%s: %s is out of the image' % (path, name))
+        data = image[offset:offset + length]
+        if zlib.crc32(data) != entry_crc:
+            sys.exit('%s: %s CRC mismatch' % (path, name))
+        if flags & FLAG_GZIP and data[:2] != b'\x1f\x8b':
+            sys.exit('%s: %s is flagged gzip but is not' % (path, name))
+        entries.append((name, flags, length))
+    return entries, size
+
+
+def verify(args):
+    entries, size = read_image(args.image)
+    print('%s: OK, %d files, %d bytes' % (args.image, len(entries), size))
+
+
+def list_image(args):
+    entries, _ = read_image(args.image)
+    for name, flags, length in entries:
+        print('%-40s %8d%s' % (name, length, ' gzip' if flags & FLAG_GZIP else ''))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest='command', required=True)
+    pack_parser = commands.add_parser('pack', help='pack a directory')
+    pack_parser.add_argument('root')
+    pack_parser.add_argument('--output', required=True)
+    pack_parser.add_argument('--exclude', action='append', default=[],
+                             help='file name or path relative to root to skip')
+    pack_parser.add_argument('--partition-size', type=lambda v: int(v, 0),
+                             help='fail if the image does not fit')
+    pack_parser.set_defaults(func=pack)
+    for name, func in (('verify', verify), ('list', list_image)):
+        sub = commands.add_parser(name, help='%s an image' % name)
+        sub.add_argument('image')
+        sub.set_defaults(func=func)
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == '__main__':
+    main()
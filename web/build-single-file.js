@@ -1,5 +1,6 @@
 const fs = require('fs');
 const path = require('path');
+const zlib = require('zlib');
 const cheerio = require('cheerio');
 
 // Установите cheerio если нет: npm install cheerio
@@ -21,3 +22,8 @@ const resultHtml = $.html();
 
 // 5. Сохраняем
 fs.writeFileSync(path.join(__dirname, 'dist', 'index.html'), resultHtml);
+
+// 6. Сжатая копия для /upload, лампа отдаёт её с Content-Encoding: gzip
+const gzipped = zlib.gzipSync(resultHtml, { level: zlib.constants.Z_BEST_COMPRESSION });
+fs.writeFileSync(path.join(__dirname, 'dist', 'index.html.gz'), gzipped);
+console.log(`index.html: ${Buffer.byteLength(resultHtml)} bytes, index.html.gz: ${gzipped.length} bytes`);
@@ -4,6 +4,7 @@ import babel from '@rollup/plugin-babel';
 import typescript from '@rollup/plugin-typescript';
 import postcss from 'rollup-plugin-postcss';
 import html from 'rollup-plugin-html';
+import { terser } from 'rollup-plugin-terser';
 
 export default {
 	input: 'src/index.tsx',
@@ -28,7 +29,7 @@ export default {
 		postcss({
 			extract: false,
 			inject: true,
-			minimize: false,
+			minimize: true,
 			modules: false
 		}),
 		resolve(),
@@ -48,7 +49,7 @@ export default {
 			],
 			extensions: ['.js', '.jsx', '.ts', '.tsx']
 		}),
-		// terser()
+		terser()
 	]
 };
 